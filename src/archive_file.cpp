@@ -5,125 +5,503 @@
 #include <string>
 #include <cstring>
 #include <iomanip>
+#include <atomic>
+#include <algorithm>
+#include <functional>
 
 #include <zlib.h>
 #include <bzlib.h>
 
 #include "decoder.hpp"
 #include "lvltwodef.hpp"
+#include "parallel.hpp"
+#include "mapped_file.hpp"
+#include "backend.hpp"
 
 
-int Decoder::ArchiveFile::decompressGzip(const std::string &file_name, std::vector<uint8_t> &out, const bool &gzip){
-	std::ifstream file(file_name, std::ios::binary);
+uint64_t Decoder::ArchiveFile::gzipSizeHint(const uint8_t *trailer, uint64_t compressed_size){
+	// ISIZE trailer is the (little endian) uncompressed size mod 2^32
+	uint64_t isize = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | (static_cast<uint64_t>(trailer[3]) << 24);
+	return std::min({isize, compressed_size*GZIP_MAX_RATIO, GZIP_MAX_SIZE_HINT});
+}
+
+int Decoder::ArchiveFile::inflateGzip(const std::function<size_t(const uint8_t *&)> &next_chunk, uint64_t isize, std::vector<uint8_t> &out){
+	z_stream stream = {};
+	stream.zalloc = Z_NULL;
+	stream.zfree = Z_NULL;
+	stream.opaque = Z_NULL;
+
+	int ret = inflateInit2(&stream, 16+MAX_WBITS);
+	if(ret != Z_OK) return -1;
+
+	// Presize output from the ISIZE trailer so the stream inflates straight into place
+	out.resize(isize > 0 ? isize : GZIP_READ_BUFSIZE);
+
+	// Decompression loop
+	while(ret != Z_STREAM_END){
+		if(stream.avail_in == 0){
+			const uint8_t *chunk = nullptr;
+			size_t chunk_size = next_chunk(chunk);
+			if(chunk_size == 0) break; // Truncated stream
+			stream.next_in = const_cast<Bytef*>(chunk);
+			stream.avail_in = chunk_size;
+		}
+
+		stream.next_out = out.data() + stream.total_out;
+		stream.avail_out = static_cast<uInt>(std::min<uint64_t>(out.size() - stream.total_out, UINT32_MAX));
+
+		ret = inflate(&stream, Z_NO_FLUSH);
+		if(ret == Z_BUF_ERROR && stream.avail_out == 0){
+			// ISIZE was wrong (e.g. > 4GB or multiple members), so grow geometrically
+			out.resize(out.size()*2);
+		}
+		else if(ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) break;
+	}
+
+	out.resize(stream.total_out);
+	inflateEnd(&stream);
+	return (ret == Z_STREAM_END) ? 0 : -1;
+}
+
+int Decoder::ArchiveFile::decompressGzip(const std::string &file_name, std::vector<uint8_t> &out, const bool &gzip, BufferPool *pool){
+	std::ifstream file(file_name, std::ios::binary | std::ios::ate);
 	if(!file.is_open()) return -1;
-	
+	std::streamsize size = file.tellg();
+	file.seekg(0, std::ios::beg);
+
 	// Check if Gzip compressed
-	unsigned char magic[2];
+	unsigned char magic[2] = {0, 0};
 	file.read(reinterpret_cast<char*>(magic), 2);
-	file.close();
+	file.seekg(0, std::ios::beg);
 
 	out.clear();
 
-	file = std::ifstream(file_name, std::ios::binary | std::ios::ate);
-	if(!file.is_open()) return -1;
-	std::streamsize size = file.tellg();
+	if(!(magic[0] == 0x1f && magic[1] == 0x8b && gzip && size >= static_cast<std::streamsize>(GZIP_MIN_SIZE))){
+		out.resize(size);
+		file.read(reinterpret_cast<char*>(out.data()), size);
+		return file.good() ? 0 : -1;
+	}
+
+	// Whole-buffer backends take the file in one read
+	if(ActiveDecompressor(Codec::GZIP)->wholeBuffer()){
+		std::vector<uint8_t> compressed = pool ? pool->acquire(size) : std::vector<uint8_t>();
+		compressed.resize(size);
+		file.read(reinterpret_cast<char*>(compressed.data()), size);
+		int status = file.good() ? decompressGzip(compressed.data(), compressed.size(), out, pool) : -1;
+		if(pool) pool->recycle(std::move(compressed));
+		return status;
+	}
+
+	// Gzip compressed, ISIZE trailer gives the uncompressed size
+	uint8_t trailer[4];
+	file.seekg(size-4, std::ios::beg);
+	file.read(reinterpret_cast<char*>(trailer), 4);
 	file.seekg(0, std::ios::beg);
-	
-	// Gzip compressed
-	if(magic[0] == 0x1f && magic[1] == 0x8b && gzip){
-		std::vector<char> buffer(size);
-		if(!file.read(buffer.data(), size)) return -1;
-
-		z_stream stream = {};
-		stream.zalloc = Z_NULL;
-		stream.zfree = Z_NULL;
-		stream.opaque = Z_NULL;
-		stream.avail_in = size;
-		stream.next_in = reinterpret_cast<Bytef*>(buffer.data());
-
-		int ret = inflateInit2(&stream, 16+MAX_WBITS);
-		if(ret != Z_OK) return -1;
-
-		// Decompression loop
-		std::vector<uint8_t> copy_buf(4096);
-		while(ret != Z_STREAM_END){
-			stream.avail_out = copy_buf.size();
-			stream.next_out = copy_buf.data();
-
-			ret = inflate(&stream, Z_NO_FLUSH);
-			if(out.size() < stream.total_out){
-				out.insert(out.end(), copy_buf.begin(), copy_buf.begin() + (copy_buf.size() - stream.avail_out));
+	uint64_t isize = gzipSizeHint(trailer, static_cast<uint64_t>(size));
+
+	// Stream the file through inflate in large chunks rather than reading it whole
+	std::vector<uint8_t> in_buf = pool ? pool->acquire(GZIP_READ_BUFSIZE) : std::vector<uint8_t>();
+	in_buf.resize(GZIP_READ_BUFSIZE);
+	auto next_chunk = [&](const uint8_t *&chunk){
+		file.read(reinterpret_cast<char*>(in_buf.data()), in_buf.size());
+		chunk = in_buf.data();
+		return static_cast<size_t>(file.gcount());
+	};
+	int status = inflateGzip(next_chunk, isize, out);
+	if(pool) pool->recycle(std::move(in_buf));
+	if(status < 0) return -1;
+
+	// Double-gzipped feeds: peel remaining layers from memory
+	if(out.size() >= GZIP_MIN_SIZE && out[0] == 0x1f && out[1] == 0x8b){
+		std::vector<uint8_t> layer = pool ? pool->acquire() : std::vector<uint8_t>();
+		layer.swap(out);
+		status = decompressGzip(layer.data(), layer.size(), out, pool);
+		if(pool) pool->recycle(std::move(layer));
+		return status;
+	}
+
+	return 0;
+}
+
+int Decoder::ArchiveFile::decompressGzip(const uint8_t *bytes, size_t size, std::vector<uint8_t> &out, BufferPool *pool){
+	std::shared_ptr<Decompressor> backend = ActiveDecompressor(Codec::GZIP);
+	if(backend->decompress(bytes, size, out) < 0) return -1;
+
+	// Peel any nested layers
+	while(out.size() >= GZIP_MIN_SIZE && out[0] == 0x1f && out[1] == 0x8b){
+		std::vector<uint8_t> layer = pool ? pool->acquire() : std::vector<uint8_t>();
+		layer.swap(out);
+		int status = decompressGzip(layer.data(), layer.size(), out, pool);
+		if(pool) pool->recycle(std::move(layer));
+		if(status < 0) return -1;
+	}
+
+	return 0;
+}
+
+int Decoder::ArchiveFile::decompressBzip2(const uint8_t *compressed_block, size_t size, std::vector<uint8_t> &out){
+	return ActiveDecompressor(Codec::BZIP2)->decompress(compressed_block, size, out);
+}
+
+/**
+ * @brief Reads count (at most 64) bits starting at a bit offset, most significant bit first
+*/
+static uint64_t getBits(const uint8_t *in, uint64_t bit, unsigned int count){
+	uint64_t value = 0;
+	for(unsigned int i=0; i<count; i++, bit++) value = (value << 1) | ((in[bit >> 3] >> (7 - (bit & 7))) & 1);
+	return value;
+}
+
+/**
+ * @brief Appends count (at most 64) bits of value, most significant bit first, at the given bit position of out
+*/
+static void putBits(std::vector<uint8_t> &out, uint64_t &bit, uint64_t value, unsigned int count){
+	for(unsigned int i=count; i-- > 0; bit++){
+		if((bit & 7) == 0) out.push_back(0);
+		if((value >> i) & 1) out.back() |= 0x80 >> (bit & 7);
+	}
+}
+
+/**
+ * @brief Rebuilds one bzip2 block as a standalone stream: stream header, the block's bits re-aligned to a byte boundary,
+ * then the end of stream magic and a combined CRC (which for a single block is the block's own CRC)
+ * @param in Pointer to the compressed bytes
+ * @param start Bit offset of the block magic
+ * @param end Bit offset where the block ends (the next block or end of stream magic)
+ * @param out A reference to a vector to store the standalone stream in
+*/
+static void isolateBzip2Block(const uint8_t *in, uint64_t start, uint64_t end, std::vector<uint8_t> &out){
+	// Block size level 9 can hold blocks of any level
+	out.assign({'B', 'Z', 'h', '9'});
+	out.reserve(4 + (end - start)/8 + 12);
+
+	uint64_t whole_bytes = (end - start) >> 3;
+	const uint8_t *src = in + (start >> 3);
+	unsigned int shift = start & 7;
+	if(shift == 0) out.insert(out.end(), src, src + whole_bytes);
+	else for(uint64_t k=0; k<whole_bytes; k++) out.push_back(static_cast<uint8_t>((src[k] << shift) | (src[k+1] >> (8 - shift))));
+
+	uint64_t bit = out.size() * 8;
+	for(uint64_t p=start + whole_bytes*8; p<end; p++) putBits(out, bit, getBits(in, p, 1), 1);
+	putBits(out, bit, BZIP2_END_MAGIC, 48);
+	putBits(out, bit, getBits(in, start + 48, 32), 32);
+}
+
+/**
+ * @brief Decompresses one or more concatenated bzip2 streams in order with libbz2, starting a new stream after each end of stream
+ * until all of the input is consumed
+ * @param in Pointer to the bzip2 compressed bytes
+ * @param in_size Number of compressed bytes
+ * @param out A reference to a vector to store the decompressed bytes
+ * @return 0 on success, -1 on corrupt or truncated data
+*/
+static int decompressBzip2Serial(const uint8_t *in, uint64_t in_size, std::vector<uint8_t> &out){
+	out.resize(std::max(BZIP2_DECOMPRESS_BUFSIZE, out.capacity()));
+	uint64_t consumed = 0;
+	uint64_t produced = 0;
+	do{
+		bz_stream stream = {};
+		if(BZ2_bzDecompressInit(&stream, 0, 0) != BZ_OK) return -1;
+
+		int bzerr = BZ_OK;
+		while(bzerr == BZ_OK){
+			// bz_stream counts in 32 bits, so feed and drain it at most 1 GiB at a time
+			stream.avail_in = static_cast<unsigned int>(std::min<uint64_t>(in_size - consumed, 1 << 30));
+			stream.next_in = reinterpret_cast<char*>(const_cast<uint8_t*>(in + consumed));
+			if(produced == out.size()) out.resize(out.size()*2);
+			stream.next_out = reinterpret_cast<char*>(out.data() + produced);
+			stream.avail_out = static_cast<unsigned int>(std::min<uint64_t>(out.size() - produced, 1 << 30));
+
+			unsigned int avail_in = stream.avail_in;
+			unsigned int avail_out = stream.avail_out;
+			bzerr = BZ2_bzDecompress(&stream);
+			consumed += avail_in - stream.avail_in;
+			produced += avail_out - stream.avail_out;
+
+			// All input consumed without reaching the end of the stream
+			if(bzerr == BZ_OK && consumed == in_size && stream.avail_out != 0) bzerr = BZ_UNEXPECTED_EOF;
+		}
+		BZ2_bzDecompressEnd(&stream);
+		if(bzerr != BZ_STREAM_END){
+			out.clear();
+			return -1;
+		}
+	}while(consumed < in_size);
+
+	out.resize(produced);
+	return 0;
+}
+
+int Decoder::ArchiveFile::decompressBzip2Stream(const uint8_t *in, uint64_t in_size, std::vector<uint8_t> &out, unsigned int threads, BufferPool *pool){
+	// Scan every bit offset for the block and end of stream magic numbers, one slice of the input per work item
+	size_t slices = std::max<size_t>(1, std::min<uint64_t>(in_size / (1 << 16), resolveThreads(threads) * 4));
+	uint64_t slice_size = (in_size + slices - 1) / slices;
+	std::vector<std::vector<std::pair<uint64_t, bool>>> found(slices);
+	parallelFor(slices, threads, [&](size_t s){
+		uint64_t first = s * slice_size;
+		uint64_t last = std::min(in_size, first + slice_size);
+		for(uint64_t i=first; i<last; i++){
+			// 8 bytes cover a 48-bit magic starting at any of the 8 bit offsets of byte i
+			uint64_t window = 0;
+			for(uint64_t j=0; j<8; j++) window = (window << 8) | (i+j < in_size ? in[i+j] : 0);
+			for(unsigned int shift=0; shift<8; shift++){
+				if(i*8 + shift + 48 > in_size*8) break;
+				uint64_t candidate = (window >> (16 - shift)) & 0xFFFFFFFFFFFFULL;
+				if(candidate == BZIP2_BLOCK_MAGIC) found[s].push_back({i*8 + shift, true});
+				else if(candidate == BZIP2_END_MAGIC) found[s].push_back({i*8 + shift, false});
 			}
 		}
+	});
+	std::vector<std::pair<uint64_t, bool>> magics;
+	for(std::vector<std::pair<uint64_t, bool>> &slice : found) magics.insert(magics.end(), slice.begin(), slice.end());
+
+	// Each block runs up to the next magic number of either kind
+	std::vector<std::pair<uint64_t, uint64_t>> blocks;
+	for(size_t i=0; i+1<magics.size(); i++){
+		if(magics[i].second) blocks.push_back({magics[i].first, magics[i+1].first});
+	}
 
-		inflateEnd(&stream);	
-		return ret == Z_STREAM_END;
+	std::vector<std::vector<uint8_t>> decompressed(blocks.size());
+	std::atomic<bool> failed(blocks.empty());
+	parallelFor(blocks.size(), threads, [&](size_t i){
+		if(failed) return;
+		std::vector<uint8_t> isolated;
+		isolateBzip2Block(in, blocks[i].first, blocks[i].second, isolated);
+		if(pool) decompressed[i] = pool->acquire(BZIP2_DECOMPRESS_BUFSIZE);
+		if(decompressBzip2(isolated.data(), isolated.size(), decompressed[i]) < 0) failed = true;
+	});
+
+	if(!failed){
+		uint64_t total = 0;
+		for(std::vector<uint8_t> &block : decompressed) total += block.size();
+		out.clear();
+		out.reserve(total);
+		for(std::vector<uint8_t> &block : decompressed) out.insert(out.end(), block.begin(), block.end());
 	}
-	else{
-		out.resize(size);
-		file.read(reinterpret_cast<char*>(out.data()), size);
-		return file.good();
+	if(pool) for(std::vector<uint8_t> &block : decompressed) pool->recycle(std::move(block));
+	if(!failed) return 0;
+
+	// A magic number turned up inside compressed data (or the stream is damaged), so decompress it the slow way
+	return decompressBzip2Serial(in, in_size, out);
+}
+
+int Decoder::ArchiveFile::walkRecords(const uint8_t *in, uint64_t in_size, std::vector<ldm_record> &records){
+	records.clear();
+
+	// Volume header (when present) is passed through as-is
+	uint64_t pos = 0;
+	if(in_size >= VOLUME_HEADER_SIZE && std::memcmp(in, "AR2V", 4) == 0){
+		records.push_back({0, VOLUME_HEADER_SIZE, false});
+		pos = VOLUME_HEADER_SIZE;
 	}
+
+	// Each record is a 4-byte signed (big endian) size followed by that many bytes of bzip2 data
+	// A negative size marks the last record of the volume
+	uint16_t found = 0;
+	while(pos+4 <= in_size){
+		int32_t control_word = static_cast<int32_t>(
+			(static_cast<uint32_t>(in[pos]) << 24) |
+			(static_cast<uint32_t>(in[pos+1]) << 16) |
+			(static_cast<uint32_t>(in[pos+2]) << 8) |
+			static_cast<uint32_t>(in[pos+3])
+		);
+		uint64_t size = static_cast<uint64_t>(std::abs(static_cast<int64_t>(control_word)));
+		uint64_t start = pos+4;
+
+		bool bzip_stream = size >= 4 && size <= in_size-start
+			&& in[start] == 'B' && in[start+1] == 'Z' && in[start+2] == 'h' && in[start+3] >= '1' && in[start+3] <= '9';
+		if(!bzip_stream){
+			// No records at all means the archive is already decompressed, so pass the rest through
+			if(found == 0) break;
+			return -1;
+		}
+
+		records.push_back({start, size, true});
+		found++;
+		pos = start+size;
+		if(control_word < 0) break;
+	}
+
+	if(pos < in_size) records.push_back({pos, in_size-pos, false});
+	return 0;
 }
 
-int Decoder::ArchiveFile::decompressBzip2(const uint8_t *compressed_block, size_t size, std::vector<uint8_t> &out){
-	bz_stream stream = {};
-	stream.next_in = reinterpret_cast<char*>(const_cast<uint8_t*>(compressed_block));
-	stream.avail_in = size;
+void Decoder::ArchiveFile::scanRecords(const uint8_t *in, uint64_t in_size, std::vector<ldm_record> &records){
+	records.clear();
 
-	out.clear();
+	// Bytes between records (e.g. the volume header) are passed through as-is, minus each record's control word
+	uint64_t raw_start = 0;
+	for(uint64_t i=4; i+3<in_size; i++){
+		if(in[i] == 'B' && in[i+1] == 'Z' && in[i+2] == 'h' && in[i+3] >= '1' && in[i+3] <= '9'){
+			int compressed_size(
+				(in[i-4] << 24) |
+				(in[i-3] << 16) |
+				(in[i-2] << 8) |
+				in[i-1]
+			);
 
-	size_t buf_size = BZIP2_DECOMPRESS_BUFSIZE;
-	out.resize(buf_size);
+			uint64_t size = static_cast<uint64_t>(abs(compressed_size));
+			if(size < 4 || size > in_size-i){
+				// Damaged control word, so bound the record by the next bzip2 stream header instead
+				size = in_size-i;
+				for(uint64_t j=i+4; j+3<in_size; j++){
+					if(in[j] == 'B' && in[j+1] == 'Z' && in[j+2] == 'h' && in[j+3] >= '1' && in[j+3] <= '9'){
+						size = j-4-i;
+						break;
+					}
+				}
+			}
+			// A stream header directly followed by another (its control word) leaves no room for a record, so the header alone is
+			// passed on as a damaged record, which also keeps the scan moving forward
+			if(size < 4) size = 4;
 
-	stream.next_out = reinterpret_cast<char*>(out.data());
-	stream.avail_out = buf_size;
+			if(i-4 > raw_start) records.push_back({raw_start, i-4-raw_start, false});
+			records.push_back({i, size, true});
 
-	if(BZ2_bzDecompressInit(&stream, 0, 0) != BZ_OK){
-		std::cerr << "Error initializing bzlib decompression stream." << std::endl;
-		return -1;
+			raw_start = i+size;
+			i += (size-1);
+		}
 	}
 
-	// Decompress entire block
-	int bzerr;
-	while(true){
-		bzerr = BZ2_bzDecompress(&stream);
+	if(raw_start < in_size) records.push_back({raw_start, in_size-raw_start, false});
+}
 
-		if(bzerr == BZ_STREAM_END) break;
+int Decoder::ArchiveFile::decompressRecords(const uint8_t *in, uint64_t in_size, const std::vector<ldm_record> &records, unsigned int threads){
+	// Every record (compressed or not) is read straight from in, so none may reach past it
+	for(const ldm_record &record : records)
+		if(record.offset > in_size || record.size > in_size - record.offset) return -1;
+
+	// Records are independent bzip2 streams, so decompress each into its own buffer concurrently
+	std::vector<std::vector<uint8_t>> decompressed(records.size());
+	std::vector<RecordCache::Entry> cached(records.size());
+	std::vector<uint8_t> damaged(records.size(), 0);
+	std::atomic<bool> failed(false);
+	parallelFor(records.size(), threads, [&](size_t i){
+		if(!records[i].compressed || failed) return;
+		if(decompressRecord(in, records[i], decompressed[i], cached[i]) < 0){
+			damaged[i] = 1;
+			if(!archive_options.recover) failed = true;
+		}
+	});
+	if(failed){
+		for(std::vector<uint8_t> &block : decompressed) recycleBuffer(std::move(block));
+		return -1;
+	}
 
-		// If out of buffer space add another bufsize
-		if(stream.avail_out == 0){
-			size_t cur_size = out.size();
-			out.resize(cur_size + BZIP2_DECOMPRESS_BUFSIZE);
-			stream.next_out = reinterpret_cast<char*>(out.data()) + cur_size;
-			stream.avail_out = BZIP2_DECOMPRESS_BUFSIZE;
-		}	
+	// Each decompressed record becomes a segment as-is, in order, leaving out damaged records
+	for(size_t i=0; i<records.size(); i++){
+		if(damaged[i]){
+			bad_records.push_back(record_count + i);
+			recycleBuffer(std::move(decompressed[i]));
+		}
+		else if(cached[i].mapping){
+			addSegment(std::move(cached[i]));
+			blocks++;
+		}
+		else if(records[i].compressed){
+			addSegment(std::move(decompressed[i]));
+			blocks++;
+		}
+		else addSegment(copyBuffer(in+records[i].offset, records[i].size));
 	}
+	record_count += records.size();
+
+	return 0;
+}
+
+int Decoder::ArchiveFile::decompressRecord(const uint8_t *in, const ldm_record &record, std::vector<uint8_t> &out, RecordCache::Entry &cached){
+	if(archive_options.cache && (cached = archive_options.cache->lookup(in+record.offset, record.size)).mapping) return 0;
 
-	out.resize(stream.total_out_lo32);
-	BZ2_bzDecompressEnd(&stream);
+	out = acquireBuffer(BZIP2_DECOMPRESS_BUFSIZE);
+	if(decompressBzip2(in+record.offset, record.size, out) < 0) return -1;
+	if(archive_options.cache) archive_options.cache->store(in+record.offset, record.size, out.data(), out.size());
 	return 0;
 }
 
+std::vector<uint8_t> Decoder::ArchiveFile::acquireBuffer(size_t min_capacity){
+	if(archive_options.pool) return archive_options.pool->acquire(min_capacity);
+	return std::vector<uint8_t>();
+}
+
+void Decoder::ArchiveFile::recycleBuffer(std::vector<uint8_t> &&buffer){
+	if(archive_options.pool) archive_options.pool->recycle(std::move(buffer));
+}
+
+std::vector<uint8_t> Decoder::ArchiveFile::copyBuffer(const uint8_t *bytes, uint64_t size){
+	std::vector<uint8_t> copy = acquireBuffer(size);
+	copy.assign(bytes, bytes+size);
+	return copy;
+}
+
+void Decoder::ArchiveFile::addSegment(std::vector<uint8_t> &&storage){
+	if(storage.empty()){
+		recycleBuffer(std::move(storage));
+		return;
+	}
+	segment seg;
+	seg.storage = std::move(storage);
+	seg.bytes = seg.storage.data();
+	seg.size = seg.storage.size();
+	seg.start = length;
+	length += seg.size;
+	segments.push_back(std::move(seg));
+}
+
+void Decoder::ArchiveFile::addSegment(RecordCache::Entry &&cached){
+	if(cached.payload_size == 0) return;
+	segment seg;
+	seg.bytes = cached.payload;
+	seg.size = cached.payload_size;
+	seg.start = length;
+	seg.cached = std::move(cached.mapping);
+	length += seg.size;
+	segments.push_back(std::move(seg));
+}
+
+void Decoder::ArchiveFile::addSegment(const uint8_t *bytes, uint64_t size){
+	if(size == 0) return;
+	segment seg;
+	seg.bytes = bytes;
+	seg.size = size;
+	seg.start = length;
+	length += size;
+	segments.push_back(std::move(seg));
+}
+
+size_t Decoder::ArchiveFile::locate(uint64_t pos){
+	// Reads are almost always sequential, so try the current and following segments first
+	if(current < segments.size()){
+		const segment &cur = segments[current];
+		if(pos >= cur.start && pos < cur.start+cur.size) return current;
+		if(current+1 < segments.size() && pos >= segments[current+1].start && pos < segments[current+1].start+segments[current+1].size)
+			return ++current;
+	}
+
+	auto after = std::upper_bound(segments.begin(), segments.end(), pos,
+		[](uint64_t p, const segment &seg){ return p < seg.start; });
+	current = static_cast<size_t>(after - segments.begin()) - 1;
+	return current;
+}
+
 bool Decoder::ArchiveFile::ignore(uint64_t off){
 	if(!initialized) return false;
 	uint64_t new_pos = off + pointer;
-	if(!(new_pos >= 0 && new_pos < data.size())) return false;
+	if(!(new_pos >= 0 && new_pos <= length)) return false;
 	pointer = new_pos;
 	return true;
 }
 
 bool Decoder::ArchiveFile::back(uint64_t off){
 	if(!initialized) return false;
+	if(off > pointer) return false;
 	uint64_t new_pos = pointer - off;
-	if(!(new_pos >= 0 && new_pos < data.size())) return false;
 	pointer = new_pos;
 	return true;
 }
 
 bool Decoder::ArchiveFile::seek(uint64_t pos){
 	if(!initialized) return false;
-	if(!(pos >= 0 && pos < data.size())) return false;
+	if(!(pos >= 0 && pos <= length)) return false;
 	pointer = pos;
 	return true;
 }
@@ -133,10 +511,13 @@ size_t Decoder::ArchiveFile::read(uint8_t* buffer, size_t size){
 
 	size_t bytes_read = 0;
 
-	while(bytes_read < size && pointer < data.size()){
-		*(buffer+bytes_read) = data[pointer];
-		pointer++;
-		bytes_read++;
+	// Message may span segments, so copy segment by segment
+	while(bytes_read < size && pointer < length){
+		const segment &seg = segments[locate(pointer)];
+		size_t amt = static_cast<size_t>(std::min<uint64_t>(size - bytes_read, seg.start + seg.size - pointer));
+		std::memcpy(buffer+bytes_read, seg.bytes + (pointer-seg.start), amt);
+		pointer += amt;
+		bytes_read += amt;
 	}
 
 	return bytes_read;
@@ -149,29 +530,64 @@ size_t Decoder::ArchiveFile::read(char* buffer, size_t size){
 size_t Decoder::ArchiveFile::readFloat(float &buffer){
 	uint32_t raw;
 	size_t bytes_read = readIntegral(raw);
-	reverseEndian<uint32_t>(raw);
 	float val;
 	std::memcpy(&val, &raw, sizeof(raw));
 	buffer = val;
 	return bytes_read;
 }
 
+std::string_view Decoder::ArchiveFile::view(uint64_t pos, uint64_t len){
+	if(!initialized || pos >= length) return std::string_view();
+	len = std::min(len, length-pos);
+
+	// Usual case, the bytes sit within one segment
+	const segment &seg = segments[locate(pos)];
+	if(pos+len <= seg.start+seg.size) return std::string_view(reinterpret_cast<const char*>(seg.bytes + (pos-seg.start)), len);
+
+	stitched.resize(len);
+	uint64_t saved = pointer;
+	pointer = pos;
+	read(stitched.data(), len);
+	pointer = saved;
+	return std::string_view(reinterpret_cast<const char*>(stitched.data()), len);
+}
+
+std::vector<uint8_t> Decoder::ArchiveFile::getAll(){
+	std::vector<uint8_t> all;
+	all.reserve(length);
+	for(const segment &seg : segments) all.insert(all.end(), seg.bytes, seg.bytes+seg.size);
+	return all;
+}
+
+std::vector<std::string_view> Decoder::ArchiveFile::segmentViews() const{
+	std::vector<std::string_view> views;
+	views.reserve(segments.size());
+	for(const segment &seg : segments) views.emplace_back(reinterpret_cast<const char*>(seg.bytes), seg.size);
+	return views;
+}
+
 void Decoder::ArchiveFile::dump_to_file(const std::string &file_name){
 	if(!initialized) return;
-	const std::vector<uint8_t> data_buffer(data);
 	std::ofstream out(file_name, std::ios::out | std::ios::binary);
-	out.write(reinterpret_cast<const char*>(data_buffer.data()), data_buffer.size());
+	dump(out);
 	out.close();
 }
 
+int Decoder::ArchiveFile::dump(std::ostream &out){
+	if(!initialized) return -1;
+	for(const segment &seg : segments) out.write(reinterpret_cast<const char*>(seg.bytes), seg.size);
+	return out.good() ? 0 : -1;
+}
+
 void Decoder::ArchiveFile::peek(const uint64_t amt){
-	uint64_t pos_to_end = data.size() - pointer - 1;
+	uint64_t pos_to_end = (pointer < length) ? length - pointer - 1 : 0;
 	uint64_t iter = (amt <= pos_to_end) ? amt : pos_to_end;
 
 	std::ios_base::fmtflags f( std::cout.flags() );
 	std::string ascii_rep;
 	for(uint64_t i=0; i<iter; i++){
-		uint8_t byte = data[pointer+i];
+		const segment &seg = segments[locate(pointer+i)];
+		uint8_t byte = seg.bytes[pointer+i-seg.start];
 		std::cout << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << static_cast<uint16_t>(byte) << " ";
 		ascii_rep += (byte >= 32 && byte <= 126) ? static_cast<char>(byte) : '.';
 		ascii_rep += "  ";
@@ -181,55 +597,225 @@ void Decoder::ArchiveFile::peek(const uint64_t amt){
 	std::cout << ascii_rep << std::endl;
 }
 
-Decoder::ArchiveFile::ArchiveFile(const std::string &file_name, const bool &gzip, const bool &bzip){
+bool Decoder::ArchiveFile::isMapped(){
+	return mapping != nullptr && segments.size() == 1 && segments[0].bytes == mapping->data();
+}
+
+Decoder::ArchiveFile::ArchiveFile(const std::string &file_name, const ArchiveOptions &options){
+	archive_options = options;
 	initialized = false;
+	blocks = 0;
+	record_count = 0;
+	pointer = 0;
+	released = 0;
+	length = 0;
+	current = 0;
+
+	// Map non-Gzip files straight into memory rather than copying them
+	const uint8_t *in = nullptr;
+	uint64_t in_size = 0;
+	if(options.mmap){
+		std::unique_ptr<MappedFile> mapped = std::make_unique<MappedFile>();
+		if(mapped->open(file_name) == 0
+			&& !(options.gzip && mapped->size() >= GZIP_MIN_SIZE && mapped->data()[0] == 0x1f && mapped->data()[1] == 0x8b)){
+			mapping = std::move(mapped);
+			in = mapping->data();
+			in_size = mapping->size();
+		}
+	}
+
 	// Decompress entire file (returns original file in vector if uncompressed) into vector
-	std::vector<uint8_t> post_gzip;
-	if(decompressGzip(file_name, post_gzip, gzip) < 0) return;
+	std::vector<uint8_t> post_gzip = acquireBuffer(0);
+	if(in == nullptr){
+		if(decompressGzip(file_name, post_gzip, options.gzip, options.pool.get()) < 0){
+			recycleBuffer(std::move(post_gzip));
+			return;
+		}
+		in = post_gzip.data();
+		in_size = post_gzip.size();
+	}
+
+	decompress(in, in_size, post_gzip, options);
+	recycleBuffer(std::move(post_gzip));
+}
+
+Decoder::ArchiveFile::ArchiveFile(const uint8_t *bytes, size_t size, const ArchiveOptions &options){
+	archive_options = options;
+	initialized = false;
+	blocks = 0;
+	record_count = 0;
+	pointer = 0;
+	released = 0;
+	length = 0;
+	current = 0;
+
+	const uint8_t *in = bytes;
+	uint64_t in_size = size;
+
+	std::vector<uint8_t> post_gzip = acquireBuffer(0);
+	if(options.gzip && size >= GZIP_MIN_SIZE && bytes[0] == 0x1f && bytes[1] == 0x8b){
+		if(decompressGzip(bytes, size, post_gzip, options.pool.get()) < 0){
+			recycleBuffer(std::move(post_gzip));
+			return;
+		}
+		in = post_gzip.data();
+		in_size = post_gzip.size();
+	}
+
+	decompress(in, in_size, post_gzip, options);
+	recycleBuffer(std::move(post_gzip));
+}
+
+Decoder::ArchiveFile::~ArchiveFile(){
+	// Decompressed segments go back to the pool for the next archive
+	for(segment &seg : segments) recycleBuffer(std::move(seg.storage));
+}
+
+Decoder::ArchiveFile::ArchiveFile(const ArchiveOptions &options){
+	archive_options = options;
+	blocks = 0;
+	record_count = 0;
+	pointer = 0;
+	released = 0;
+	length = 0;
+	current = 0;
+	initialized = true;
+}
+
+void Decoder::ArchiveFile::decompress(const uint8_t *in, uint64_t in_size, std::vector<uint8_t> &post_gzip, const ArchiveOptions &options){
+	// A whole archive wrapped in bzip2 (rather than per LDM record) is unwrapped first, then framed as usual
+	if(options.bzip && in_size >= 10 && std::memcmp(in, "BZh", 3) == 0 && std::memcmp(in+4, "1AY&SY", 6) == 0){
+		std::vector<uint8_t> unwrapped = acquireBuffer(0);
+		if(decompressBzip2Stream(in, in_size, unwrapped, options.threads, options.pool.get()) < 0){
+			recycleBuffer(std::move(unwrapped));
+			return;
+		}
+		recycleBuffer(std::move(post_gzip));
+		post_gzip = std::move(unwrapped);
+		in = post_gzip.data();
+		in_size = post_gzip.size();
+	}
+
+	// Frame the archive into LDM records by following each record's control word
+	if(options.bzip && walkRecords(in, in_size, ldm_records) < 0){
+		if(!options.recover){
+			std::cerr << "Malformed LDM record control word. Archive file may be corrupt." << std::endl;
+			return;
+		}
+		// Recovery mode: fall back to scanning every byte for bzip2 stream headers
+		scanRecords(in, in_size, ldm_records);
+	}
 
-	if(!bzip){
-		data.reserve(post_gzip.size());
-		data.insert(data.end(), post_gzip.begin(), post_gzip.end());
-		pointer = 0;
+	// Nothing to decompress, so the cursor runs directly over the input (mapped pages, caller bytes, or the Gzip output)
+	bool compressed = false;
+	for(const ldm_record &record : ldm_records) compressed |= record.compressed;
+	if(!compressed){
+		if(!post_gzip.empty() && in == post_gzip.data()) addSegment(std::move(post_gzip));
+		else addSegment(in, in_size);
 		initialized = true;
 		return;
 	}
 
-	// Search for BZip2 compressed blocks
-	// This could be made quicker by identifying where the blocks are located and then doing the decompression in parallel
-	blocks = 0;
-	for(uint64_t i=0; i<post_gzip.size()-3; i++){
-		// format for block is 4-byte signed integer of size of block, BZhx where x is the compression block size. the compressed block follows
-		if(post_gzip[i] == 'B' && post_gzip[i+1] == 'Z' && post_gzip[i+2] == 'h' && post_gzip[i+3] >= '1' && post_gzip[i+3] <= '9'){
-			blocks++;
+	// Decompress all records concurrently
+	if(options.threads != 1){
+		if(decompressRecords(in, in_size, ldm_records, options.threads) < 0) return;
 
-			std::vector<uint8_t> decompressed_block;
-			int compressed_size(
-				(post_gzip[i-4] << 24) |
-				(post_gzip[i-3] << 16) |
-				(post_gzip[i-2] << 8) |
-				post_gzip[i-1]
-			);
+		initialized = true;
+		return;
+	}
 
-			size_t size = static_cast<size_t>(abs(compressed_size));
-			if(decompressBzip2(&post_gzip[i], size, decompressed_block) < 0) return;
+	if(appendRecords(in, ldm_records) < 0) return;
 
-			// Append decompressed block to data but remove the compressed size
-			data.resize(data.size()-4);
-			data.insert(data.end(), decompressed_block.begin(), decompressed_block.end());
-			data.shrink_to_fit();
-			i += (size-1);
+	initialized = true;
+}
 
-			std::string dump = "blocks/BLOCK_DUMP" + std::to_string(blocks);
-			std::ofstream out(dump, std::ios::out | std::ios::binary);
-			out.write(reinterpret_cast<const char*>(decompressed_block.data()), decompressed_block.size());
-			out.close();
+int Decoder::ArchiveFile::appendRecords(const uint8_t *in, const std::vector<ldm_record> &records){
+	for(const ldm_record &record : records){
+		size_t index = record_count++;
+		if(!record.compressed){
+			addSegment(copyBuffer(in+record.offset, record.size));
+			continue;
 		}
-		else{
-			data.push_back(post_gzip[i]);
+
+		// Each record is decompressed straight into its own segment
+		std::vector<uint8_t> decompressed_block;
+		RecordCache::Entry cached;
+		if(decompressRecord(in, record, decompressed_block, cached) < 0){
+			recycleBuffer(std::move(decompressed_block));
+			if(!archive_options.recover) return -1;
+
+			// Records hold whole messages, so the rest of the volume still parses without this one
+			bad_records.push_back(index);
+			continue;
 		}
+		if(cached.mapping) addSegment(std::move(cached));
+		else addSegment(std::move(decompressed_block));
+		blocks++;
 	}
 
+	return 0;
+}
+
+void Decoder::ArchiveFile::release(){
+	if(!initialized) return;
+
+	// Drop every segment entirely before the pointer, then trim the one holding it
+	size_t consumed = 0;
+	while(consumed < segments.size() && segments[consumed].start + segments[consumed].size <= pointer){
+		recycleBuffer(std::move(segments[consumed].storage));
+		consumed++;
+	}
+	segments.erase(segments.begin(), segments.begin()+consumed);
+	if(!segments.empty() && segments[0].start < pointer){
+		uint64_t trim = pointer - segments[0].start;
+		segments[0].bytes += trim;
+		segments[0].size -= trim;
+	}
+
+	length = 0;
+	for(segment &seg : segments){
+		seg.start = length;
+		length += seg.size;
+	}
+	released += pointer;
 	pointer = 0;
-	initialized = true;
-}
\ No newline at end of file
+	current = 0;
+}
+
+int Decoder::ArchiveFile::append(const uint8_t *bytes, size_t size){
+	if(!initialized) return -1;
+	if(!(archive_options.gzip && size >= GZIP_MIN_SIZE && bytes[0] == 0x1f && bytes[1] == 0x8b))
+		return appendChunk(bytes, size);
+
+	std::vector<uint8_t> post_gzip = acquireBuffer(0);
+	int status = decompressGzip(bytes, size, post_gzip, archive_options.pool.get());
+	if(status == 0) status = appendChunk(post_gzip.data(), post_gzip.size());
+	recycleBuffer(std::move(post_gzip));
+	return status;
+}
+
+int Decoder::ArchiveFile::appendChunk(const uint8_t *in, uint64_t in_size){
+	std::vector<ldm_record> records;
+	if(!archive_options.bzip) records.push_back({0, in_size, false});
+	else if(walkRecords(in, in_size, records) < 0){
+		if(!archive_options.recover){
+			std::cerr << "Malformed LDM record control word. Archive chunk may be corrupt." << std::endl;
+			return -1;
+		}
+		scanRecords(in, in_size, records);
+	}
+
+	return appendRecords(in, records);
+}
+
+int Decoder::ArchiveFile::append(std::vector<uint8_t> &&bytes){
+	if(!initialized) return -1;
+	addSegment(std::move(bytes));
+	return 0;
+}
+
+int Decoder::ArchiveFile::append(RecordCache::Entry &&cached){
+	if(!initialized) return -1;
+	addSegment(std::move(cached));
+	return 0;
+}
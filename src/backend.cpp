@@ -0,0 +1,322 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+
+#include <zlib.h>
+#include <bzlib.h>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <dlfcn.h>
+#endif
+
+#include "backend.hpp"
+#include "decoder.hpp"
+#include "lvltwodef.hpp"
+
+#ifndef OPENREFLECTIVITY_GZIP_BACKEND
+#define OPENREFLECTIVITY_GZIP_BACKEND "zlib"
+#endif
+
+#ifndef OPENREFLECTIVITY_BZIP2_BACKEND
+#define OPENREFLECTIVITY_BZIP2_BACKEND "bzlib"
+#endif
+
+
+/**
+ * @class ZlibDecompressor
+ * @brief Reference Gzip backend, zlib inflate straight into a buffer presized from the ISIZE trailer
+*/
+class ZlibDecompressor : public Decoder::Decompressor{
+public:
+	std::string name() const override { return "zlib"; }
+	Decoder::Codec codec() const override { return Decoder::Codec::GZIP; }
+	bool wholeBuffer() const override { return false; }
+
+	int decompress(const uint8_t *in, size_t in_size, std::vector<uint8_t> &out) const override{
+		out.clear();
+		if(in_size < GZIP_MIN_SIZE) return -1;
+
+		uint64_t isize = Decoder::ArchiveFile::gzipSizeHint(in + in_size - 4, in_size);
+
+		// Whole stream is already in memory, so hand it to inflate as a single chunk
+		bool consumed = false;
+		auto next_chunk = [&](const uint8_t *&chunk){
+			if(consumed) return static_cast<size_t>(0);
+			consumed = true;
+			chunk = in;
+			return in_size;
+		};
+		return Decoder::ArchiveFile::inflateGzip(next_chunk, isize, out);
+	}
+};
+
+/**
+ * @class BzlibDecompressor
+ * @brief Reference bzip2 backend, libbz2 decompression into a buffer doubled as needed
+*/
+class BzlibDecompressor : public Decoder::Decompressor{
+public:
+	std::string name() const override { return "bzlib"; }
+	Decoder::Codec codec() const override { return Decoder::Codec::BZIP2; }
+
+	int decompress(const uint8_t *in, size_t in_size, std::vector<uint8_t> &out) const override{
+		bz_stream stream = {};
+		stream.next_in = reinterpret_cast<char*>(const_cast<uint8_t*>(in));
+		stream.avail_in = in_size;
+
+		out.clear();
+
+		// Use all of the capacity a (pooled) out vector already has
+		size_t buf_size = std::max(BZIP2_DECOMPRESS_BUFSIZE, out.capacity());
+		out.resize(buf_size);
+
+		stream.next_out = reinterpret_cast<char*>(out.data());
+		stream.avail_out = buf_size;
+
+		if(BZ2_bzDecompressInit(&stream, 0, 0) != BZ_OK){
+			std::cerr << "Error initializing bzlib decompression stream." << std::endl;
+			return -1;
+		}
+
+		// Decompress entire block, giving up as soon as the stream is corrupt, truncated or runs away
+		int bzerr;
+		while(true){
+			bzerr = BZ2_bzDecompress(&stream);
+
+			if(bzerr == BZ_STREAM_END) break;
+
+			if(bzerr != BZ_OK){
+				std::cerr << "Corrupt bzip2 record (bzlib error " << bzerr << ")." << std::endl;
+				BZ2_bzDecompressEnd(&stream);
+				return -1;
+			}
+
+			// If out of buffer space double the buffer
+			if(stream.avail_out == 0){
+				size_t cur_size = out.size();
+				if(cur_size >= BZIP2_MAX_RECORD_SIZE){
+					std::cerr << "Bzip2 record decompresses past " << BZIP2_MAX_RECORD_SIZE << " bytes. Record may be corrupt." << std::endl;
+					BZ2_bzDecompressEnd(&stream);
+					return -1;
+				}
+				out.resize(cur_size*2);
+				stream.next_out = reinterpret_cast<char*>(out.data()) + cur_size;
+				stream.avail_out = cur_size;
+			}
+			// Output space left but all input consumed without reaching the end of the stream
+			else if(stream.avail_in == 0){
+				std::cerr << "Truncated bzip2 record." << std::endl;
+				BZ2_bzDecompressEnd(&stream);
+				return -1;
+			}
+		}
+
+		out.resize(stream.total_out_lo32);
+		BZ2_bzDecompressEnd(&stream);
+		return 0;
+	}
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+/**
+ * @class LibdeflateDecompressor
+ * @brief Gzip backend using a system libdeflate (whole-buffer inflate), loaded at run time so no build dependency is needed
+*/
+class LibdeflateDecompressor : public Decoder::Decompressor{
+private:
+	typedef void *(*alloc_fn)();
+	typedef void (*free_fn)(void*);
+	typedef int (*gzip_fn)(void*, const void*, size_t, void*, size_t, size_t*, size_t*);
+
+	alloc_fn alloc_decompressor;
+	free_fn free_decompressor;
+	gzip_fn gzip_decompress;
+
+	// libdeflate_result values
+	static constexpr int SUCCESS = 0;
+	static constexpr int INSUFFICIENT_SPACE = 3;
+
+	LibdeflateDecompressor(alloc_fn alloc, free_fn release, gzip_fn gzip) : alloc_decompressor(alloc), free_decompressor(release), gzip_decompress(gzip) {}
+
+public:
+	/**
+	 * @brief Loads libdeflate if the system has it (the library stays loaded for the life of the process)
+	 * @return The backend, or nullptr when libdeflate is unavailable
+	*/
+	static std::shared_ptr<Decoder::Decompressor> load(){
+		for(const char *library : {"libdeflate.so.0", "libdeflate.so", "libdeflate.0.dylib", "libdeflate.dylib"}){
+			void *handle = dlopen(library, RTLD_NOW | RTLD_LOCAL);
+			if(handle == nullptr) continue;
+
+			alloc_fn alloc = reinterpret_cast<alloc_fn>(dlsym(handle, "libdeflate_alloc_decompressor"));
+			free_fn release = reinterpret_cast<free_fn>(dlsym(handle, "libdeflate_free_decompressor"));
+			gzip_fn gzip = reinterpret_cast<gzip_fn>(dlsym(handle, "libdeflate_gzip_decompress_ex"));
+			if(alloc && release && gzip) return std::shared_ptr<Decoder::Decompressor>(new LibdeflateDecompressor(alloc, release, gzip));
+			dlclose(handle);
+		}
+		return nullptr;
+	}
+
+	std::string name() const override { return "libdeflate"; }
+	Decoder::Codec codec() const override { return Decoder::Codec::GZIP; }
+
+	int decompress(const uint8_t *in, size_t in_size, std::vector<uint8_t> &out) const override{
+		out.clear();
+		if(in_size < GZIP_MIN_SIZE) return -1;
+
+		uint64_t isize = Decoder::ArchiveFile::gzipSizeHint(in + in_size - 4, in_size);
+		out.resize(std::max<uint64_t>(isize, out.capacity()));
+
+		// Decompressors are not thread safe, so each call gets its own
+		void *decompressor = alloc_decompressor();
+		if(decompressor == nullptr) return -1;
+
+		// Like the reference, only the first member is decompressed; ISIZE is only a hint (mod 2^32), so grow until it fits
+		int result;
+		size_t in_used = 0;
+		size_t out_used = 0;
+		while((result = gzip_decompress(decompressor, in, in_size, out.data(), out.size(), &in_used, &out_used)) == INSUFFICIENT_SPACE)
+			out.resize(std::max<size_t>(out.size()*2, GZIP_READ_BUFSIZE));
+		free_decompressor(decompressor);
+
+		if(result != SUCCESS){
+			out.clear();
+			return -1;
+		}
+		out.resize(out_used);
+		return 0;
+	}
+};
+#endif
+
+/**
+ * @brief Holds every available backend and the active one per codec
+*/
+typedef struct {
+	std::mutex lock;
+	std::vector<std::shared_ptr<Decoder::Decompressor>> backends;
+	std::shared_ptr<Decoder::Decompressor> active[2];
+} backend_registry;
+
+static backend_registry &registry(){
+	static backend_registry *instance = [](){
+		backend_registry *reg = new backend_registry();
+		reg->backends.push_back(std::make_shared<ZlibDecompressor>());
+		reg->backends.push_back(std::make_shared<BzlibDecompressor>());
+#if defined(__unix__) || defined(__APPLE__)
+		std::shared_ptr<Decoder::Decompressor> libdeflate = LibdeflateDecompressor::load();
+		if(libdeflate) reg->backends.push_back(libdeflate);
+#endif
+
+		// Build time choice when available, else the reference
+		reg->active[static_cast<int>(Decoder::Codec::GZIP)] = reg->backends[0];
+		reg->active[static_cast<int>(Decoder::Codec::BZIP2)] = reg->backends[1];
+		for(const std::shared_ptr<Decoder::Decompressor> &backend : reg->backends){
+			if(backend->codec() == Decoder::Codec::GZIP && backend->name() == OPENREFLECTIVITY_GZIP_BACKEND)
+				reg->active[static_cast<int>(Decoder::Codec::GZIP)] = backend;
+			if(backend->codec() == Decoder::Codec::BZIP2 && backend->name() == OPENREFLECTIVITY_BZIP2_BACKEND)
+				reg->active[static_cast<int>(Decoder::Codec::BZIP2)] = backend;
+		}
+		return reg;
+	}();
+	return *instance;
+}
+
+void Decoder::RegisterDecompressor(std::shared_ptr<Decompressor> backend){
+	if(!backend) return;
+	backend_registry &reg = registry();
+	std::lock_guard<std::mutex> guard(reg.lock);
+	reg.backends.push_back(std::move(backend));
+}
+
+std::vector<std::shared_ptr<Decoder::Decompressor>> Decoder::AvailableDecompressors(Codec codec){
+	backend_registry &reg = registry();
+	std::lock_guard<std::mutex> guard(reg.lock);
+	std::vector<std::shared_ptr<Decompressor>> available;
+	for(const std::shared_ptr<Decompressor> &backend : reg.backends){
+		if(backend->codec() == codec) available.push_back(backend);
+	}
+	return available;
+}
+
+std::shared_ptr<Decoder::Decompressor> Decoder::ActiveDecompressor(Codec codec){
+	backend_registry &reg = registry();
+	std::lock_guard<std::mutex> guard(reg.lock);
+	return reg.active[static_cast<int>(codec)];
+}
+
+int Decoder::SelectDecompressor(Codec codec, const std::string &name){
+	backend_registry &reg = registry();
+	std::lock_guard<std::mutex> guard(reg.lock);
+	for(const std::shared_ptr<Decompressor> &backend : reg.backends){
+		if(backend->codec() == codec && backend->name() == name){
+			reg.active[static_cast<int>(codec)] = backend;
+			return 0;
+		}
+	}
+	std::cerr << "No decompression backend named " << name << std::endl;
+	return -1;
+}
+
+std::vector<Decoder::BackendBenchmark> Decoder::BenchmarkDecompressors(size_t sample_size, unsigned int repetitions){
+	// Synthetic moment data: runs of below-threshold gates broken by noisy echoes, roughly as compressible as real radials
+	std::vector<uint8_t> sample(sample_size);
+	uint32_t state = 12345;
+	uint8_t level = 0;
+	for(size_t i=0; i<sample_size; i++){
+		state = state*1103515245 + 12345;
+		uint32_t noise = state >> 16;
+		if(noise % 97 == 0) level = (level == 0) ? static_cast<uint8_t>(40 + noise % 120) : 0;
+		sample[i] = (level == 0) ? 0 : static_cast<uint8_t>(level + (noise & 7));
+	}
+
+	std::vector<uint8_t> gzipped(compressBound(sample_size) + GZIP_MIN_SIZE);
+	z_stream deflate_stream = {};
+	deflateInit2(&deflate_stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16+MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+	deflate_stream.next_in = sample.data();
+	deflate_stream.avail_in = sample_size;
+	deflate_stream.next_out = gzipped.data();
+	deflate_stream.avail_out = gzipped.size();
+	deflate(&deflate_stream, Z_FINISH);
+	gzipped.resize(deflate_stream.total_out);
+	deflateEnd(&deflate_stream);
+
+	std::vector<uint8_t> bzipped(sample_size + sample_size/100 + 600);
+	unsigned int bzipped_size = bzipped.size();
+	BZ2_bzBuffToBuffCompress(reinterpret_cast<char*>(bzipped.data()), &bzipped_size, reinterpret_cast<char*>(sample.data()), sample_size, 9, 0, 0);
+	bzipped.resize(bzipped_size);
+
+	std::vector<BackendBenchmark> results;
+	for(Codec codec : {Codec::GZIP, Codec::BZIP2}){
+		const std::vector<uint8_t> &compressed = (codec == Codec::GZIP) ? gzipped : bzipped;
+		size_t fastest = SIZE_MAX;
+		for(const std::shared_ptr<Decompressor> &backend : AvailableDecompressors(codec)){
+			BackendBenchmark result = {backend->name(), codec, 0.0, false, false};
+
+			// Untimed run to check the output and warm the output buffer
+			std::vector<uint8_t> out;
+			result.correct = backend->decompress(compressed.data(), compressed.size(), out) == 0 && out == sample;
+			if(result.correct){
+				std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+				for(unsigned int r=0; r<std::max(1u, repetitions); r++) backend->decompress(compressed.data(), compressed.size(), out);
+				double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				result.throughput = (static_cast<double>(sample_size) * std::max(1u, repetitions) / 1e6) / std::max(seconds, 1e-9);
+			}
+
+			if(result.correct && (fastest == SIZE_MAX || result.throughput > results[fastest].throughput))
+				fastest = results.size();
+			results.push_back(result);
+		}
+
+		if(fastest != SIZE_MAX){
+			results[fastest].selected = true;
+			SelectDecompressor(codec, results[fastest].name);
+		}
+	}
+
+	return results;
+}
@@ -0,0 +1,122 @@
+/**
+ * @file backend.hpp
+ * @brief Header file for the interchangeable decompression backends used by ArchiveFile
+ * @author Owen Capell
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @namespace Decoder
+ * @brief Encapsulate decoding functions
+*/
+namespace Decoder
+{
+	/**
+	 * @brief Compression formats a backend may decompress
+	*/
+	enum class Codec {GZIP, BZIP2};
+
+	/**
+	 * @class Decompressor
+	 * @brief Interface for one implementation of whole-buffer decompression of a codec
+	 * The zlib and libbz2 backends are always available and are the reference implementations
+	*/
+	class Decompressor{
+	public:
+		virtual ~Decompressor() = default;
+
+		/**
+		 * @brief Tells the name the backend is selected by
+		 * @return Backend name
+		*/
+		virtual std::string name() const = 0;
+
+		/**
+		 * @brief Tells which codec the backend decompresses
+		 * @return Codec of the backend
+		*/
+		virtual Codec codec() const = 0;
+
+		/**
+		 * @brief Tells whether the backend needs the whole compressed input at once (the reference Gzip backend is instead streamed through by ArchiveFile)
+		 * @return Boolean indicator of whether input must be whole
+		*/
+		virtual bool wholeBuffer() const { return true; }
+
+		/**
+		 * @brief Decompresses one complete stream (Gzip: the first member of one layer, any further members are ignored; bzip2: one stream) held in memory
+		 * Must be safe to call from several threads at once
+		 * @param in Pointer to the compressed bytes
+		 * @param in_size Number of compressed bytes
+		 * @param out A reference to a vector to store the decompressed bytes, whose existing capacity is used first
+		 * @return 0 on success, -1 on any error
+		*/
+		virtual int decompress(const uint8_t *in, size_t in_size, std::vector<uint8_t> &out) const = 0;
+	};
+
+	/**
+	 * @struct BackendBenchmark
+	 * @brief Result of timing one backend on the built-in benchmark sample
+	 * @member name
+	 * Member 'name' is the name of the backend
+	 * @member codec
+	 * Member 'codec' is the codec of the backend
+	 * @member throughput
+	 * Member 'throughput' is the decompressed megabytes (10^6 bytes) produced per second
+	 * @member correct
+	 * Member 'correct' is whether the backend reproduced the sample exactly (incorrect backends are never selected)
+	 * @member selected
+	 * Member 'selected' is whether the backend was made the active one for its codec
+	*/
+	struct BackendBenchmark{
+		std::string name;
+		Codec codec;
+		double throughput;
+		bool correct;
+		bool selected;
+	};
+
+	/**
+	 * @brief Adds a backend, making it available for selection (the active backends are left unchanged)
+	 * @param backend Backend to add
+	*/
+	void RegisterDecompressor(std::shared_ptr<Decompressor> backend);
+
+	/**
+	 * @brief Lists the backends available for a codec, reference implementation first
+	 * @param codec Codec to list backends of
+	 * @return Vector of available backends
+	*/
+	std::vector<std::shared_ptr<Decompressor>> AvailableDecompressors(Codec codec);
+
+	/**
+	 * @brief Gives the backend ArchiveFile currently decompresses a codec with
+	 * Starts as the backend named at build time (OPENREFLECTIVITY_GZIP_BACKEND/OPENREFLECTIVITY_BZIP2_BACKEND) when available, else the reference
+	 * @param codec Codec to get the backend of
+	 * @return Active backend
+	*/
+	std::shared_ptr<Decompressor> ActiveDecompressor(Codec codec);
+
+	/**
+	 * @brief Makes the named backend the active one for a codec
+	 * @param codec Codec to select the backend of
+	 * @param name Name of the backend
+	 * @return 0 on success, -1 if no such backend is available
+	*/
+	int SelectDecompressor(Codec codec, const std::string &name);
+
+	/**
+	 * @brief Times every available backend decompressing a built-in synthetic sample and makes the fastest correct one active for each codec
+	 * @param sample_size Number of uncompressed sample bytes
+	 * @param repetitions Number of timed runs per backend
+	 * @return Vector of results, one per backend
+	*/
+	std::vector<BackendBenchmark> BenchmarkDecompressors(size_t sample_size = 1 << 21, unsigned int repetitions = 3);
+}
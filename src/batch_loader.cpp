@@ -0,0 +1,355 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <cerrno>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register) && defined(IO_URING_OP_SUPPORTED)
+#define OPENREFLECTIVITY_IO_URING 1
+#endif
+#endif
+#endif
+
+#include "batch_loader.hpp"
+#include "decoder.hpp"
+#include "parallel.hpp"
+#include "volume_pool.hpp"
+
+// Largest single read submitted for a file, larger files are read in several parts
+constexpr uint64_t BATCH_READ_MAX = 1 << 30;
+
+
+#ifdef OPENREFLECTIVITY_IO_URING
+/**
+ * @class IoUring
+ * @brief A minimal io_uring instance (submission and completion rings mapped directly, no liburing needed) for queueing reads
+*/
+class IoUring{
+private:
+	int ring_fd;
+	void *sq_ring;
+	void *cq_ring;
+	size_t sq_ring_size;
+	size_t cq_ring_size;
+	io_uring_sqe *sqes;
+	size_t sqes_size;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	io_uring_cqe *cqes;
+	unsigned int queued;
+
+public:
+	IoUring() : ring_fd(-1), sq_ring(MAP_FAILED), cq_ring(MAP_FAILED), sqes(static_cast<io_uring_sqe*>(MAP_FAILED)), queued(0) {}
+
+	~IoUring(){ teardown(); }
+
+	IoUring(const IoUring&) = delete;
+	IoUring& operator=(const IoUring&) = delete;
+
+	/**
+	 * @brief Unmaps the rings and closes the ring, which cancels or waits out any reads still in flight so their buffers may be freed
+	*/
+	void teardown(){
+		if(sqes != MAP_FAILED) munmap(sqes, sqes_size);
+		if(cq_ring != MAP_FAILED && cq_ring != sq_ring) munmap(cq_ring, cq_ring_size);
+		if(sq_ring != MAP_FAILED) munmap(sq_ring, sq_ring_size);
+		if(ring_fd >= 0) close(ring_fd);
+		sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+		sq_ring = cq_ring = MAP_FAILED;
+		ring_fd = -1;
+	}
+
+	/**
+	 * @brief Creates the rings
+	 * @param entries Number of submission queue entries
+	 * @return 0 on success, -1 if io_uring is unavailable (old kernel, seccomp, disabled by sysctl) or cannot read
+	*/
+	int setup(unsigned int entries){
+		io_uring_params params = {};
+		ring_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+		if(ring_fd < 0) return -1;
+
+		// Kernels 5.1-5.5 have io_uring but no IORING_OP_READ (nor probing, which came with it), every read would fail with -EINVAL
+		uint8_t probe_storage[sizeof(io_uring_probe) + (IORING_OP_READ+1)*sizeof(io_uring_probe_op)] = {};
+		io_uring_probe *probe = reinterpret_cast<io_uring_probe*>(probe_storage);
+		if(syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PROBE, probe, IORING_OP_READ+1) < 0
+			|| probe->last_op < IORING_OP_READ || !(probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED))
+			return -1;
+
+		sq_ring_size = params.sq_off.array + params.sq_entries*sizeof(unsigned int);
+		cq_ring_size = params.cq_off.cqes + params.cq_entries*sizeof(io_uring_cqe);
+		bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+		if(single_mmap) sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+		sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+		if(sq_ring == MAP_FAILED) return -1;
+		cq_ring = single_mmap ? sq_ring : mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+		if(cq_ring == MAP_FAILED) return -1;
+		sqes_size = params.sq_entries*sizeof(io_uring_sqe);
+		sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES));
+		if(sqes == MAP_FAILED) return -1;
+
+		uint8_t *sq = static_cast<uint8_t*>(sq_ring);
+		uint8_t *cq = static_cast<uint8_t*>(cq_ring);
+		sq_tail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+		sq_mask = reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+		sq_array = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+		cq_head = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+		cq_tail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+		cq_mask = reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+		cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+		return 0;
+	}
+
+	/**
+	 * @brief Queues a read (submitted by the next wait)
+	*/
+	void read(int fd, uint8_t *buffer, unsigned int size, uint64_t offset, uint64_t user_data){
+		unsigned int tail = *sq_tail;
+		unsigned int index = tail & *sq_mask;
+		io_uring_sqe &sqe = sqes[index];
+		sqe = io_uring_sqe{};
+		sqe.opcode = IORING_OP_READ;
+		sqe.fd = fd;
+		sqe.addr = reinterpret_cast<uint64_t>(buffer);
+		sqe.len = size;
+		sqe.off = offset;
+		sqe.user_data = user_data;
+		sq_array[index] = index;
+		// Entry must be visible to the kernel before the new tail
+		__atomic_store_n(sq_tail, tail+1, __ATOMIC_RELEASE);
+		queued++;
+	}
+
+	/**
+	 * @brief Submits queued reads and waits for at least one completion
+	 * @return 0 on success, -1 on any error
+	*/
+	int wait(){
+		while(true){
+			long ret = syscall(__NR_io_uring_enter, ring_fd, queued, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+			if(ret >= 0){
+				queued -= static_cast<unsigned int>(std::min<long>(ret, queued));
+				return 0;
+			}
+			if(errno != EINTR) return -1;
+		}
+	}
+
+	/**
+	 * @brief Hands every available completion (user data, result) to fn
+	*/
+	template <typename F>
+	void reap(F &&fn){
+		unsigned int head = *cq_head;
+		while(head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)){
+			io_uring_cqe cqe = cqes[head & *cq_mask];
+			head++;
+			__atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+			fn(cqe.user_data, cqe.res);
+		}
+	}
+};
+#endif
+
+Decoder::BatchLoader::BatchLoader(unsigned int depth, std::shared_ptr<BufferPool> pool, bool io_uring)
+	: depth(std::max(1u, depth)), try_io_uring(io_uring), used_io_uring(false), pool(std::move(pool)) {}
+
+int Decoder::BatchLoader::load(const std::vector<std::string> &file_names, const std::function<void(size_t, int, std::vector<uint8_t>&&)> &on_loaded){
+	used_io_uring = false;
+	if(try_io_uring){
+		int status = loadIoUring(file_names, on_loaded);
+		if(status != -2){
+			used_io_uring = true;
+			return status;
+		}
+	}
+	return loadThreaded(file_names, on_loaded);
+}
+
+int Decoder::BatchLoader::loadIoUring(const std::vector<std::string> &file_names, const std::function<void(size_t, int, std::vector<uint8_t>&&)> &on_loaded){
+#ifdef OPENREFLECTIVITY_IO_URING
+	typedef struct {
+		size_t index;
+		int fd;
+		uint64_t size;
+		uint64_t done;
+		std::vector<uint8_t> bytes;
+	} file_read;
+
+	// Declared before the ring so that, on every exit, the ring is torn down before the buffers reads may still target are freed
+	std::vector<file_read> slots(depth);
+	IoUring ring;
+	if(ring.setup(depth) < 0) return -2;
+	std::vector<size_t> free_slots;
+	for(size_t s=depth; s-- > 0;) free_slots.push_back(s);
+
+	int status = 0;
+	auto fail = [&](size_t index){
+		status = -1;
+		on_loaded(index, -1, std::vector<uint8_t>());
+	};
+	auto queue_read = [&](size_t s){
+		file_read &slot = slots[s];
+		unsigned int amt = static_cast<unsigned int>(std::min(slot.size - slot.done, BATCH_READ_MAX));
+		ring.read(slot.fd, slot.bytes.data() + slot.done, amt, slot.done, s);
+	};
+
+	size_t next = 0;
+	while(next < file_names.size() || free_slots.size() < depth){
+		// Keep every slot busy with a file
+		while(!free_slots.empty() && next < file_names.size()){
+			size_t index = next++;
+			int fd = open(file_names[index].c_str(), O_RDONLY);
+			struct stat info;
+			if(fd < 0 || fstat(fd, &info) < 0){
+				if(fd >= 0) close(fd);
+				fail(index);
+				continue;
+			}
+			if(info.st_size == 0){
+				close(fd);
+				on_loaded(index, 0, std::vector<uint8_t>());
+				continue;
+			}
+
+			size_t s = free_slots.back();
+			free_slots.pop_back();
+			file_read &slot = slots[s];
+			slot.index = index;
+			slot.fd = fd;
+			slot.size = static_cast<uint64_t>(info.st_size);
+			slot.done = 0;
+			slot.bytes = pool ? pool->acquire(slot.size) : std::vector<uint8_t>();
+			slot.bytes.resize(slot.size);
+			queue_read(s);
+		}
+		if(free_slots.size() == depth) break;
+
+		if(ring.wait() < 0){
+			std::cerr << "io_uring wait failed." << std::endl;
+			// Reads may still be in flight, the buffers are only reusable once the ring is gone
+			ring.teardown();
+			for(size_t s=0; s<depth; s++){
+				if(std::find(free_slots.begin(), free_slots.end(), s) != free_slots.end()) continue;
+				close(slots[s].fd);
+				if(pool) pool->recycle(std::move(slots[s].bytes));
+				fail(slots[s].index);
+			}
+			return -1;
+		}
+
+		ring.reap([&](uint64_t s, int res){
+			file_read &slot = slots[s];
+			if(res == -EINTR || res == -EAGAIN){
+				queue_read(s);
+				return;
+			}
+			if(res > 0) slot.done += static_cast<uint64_t>(res);
+			// More to read (short read or a file larger than one read)
+			if(res > 0 && slot.done < slot.size){
+				queue_read(s);
+				return;
+			}
+
+			close(slot.fd);
+			free_slots.push_back(s);
+			if(res < 0){
+				if(pool) pool->recycle(std::move(slot.bytes));
+				fail(slot.index);
+				return;
+			}
+			// File shrank while reading
+			slot.bytes.resize(slot.done);
+			on_loaded(slot.index, 0, std::move(slot.bytes));
+		});
+	}
+
+	return status;
+#else
+	return -2;
+#endif
+}
+
+int Decoder::BatchLoader::loadThreaded(const std::vector<std::string> &file_names, const std::function<void(size_t, int, std::vector<uint8_t>&&)> &on_loaded){
+	typedef struct {
+		size_t index;
+		int status;
+		std::vector<uint8_t> bytes;
+	} loaded_file;
+
+	// Readers hand files to the calling thread, at most one waiting per reader
+	BoundedQueue<loaded_file> loaded(depth);
+	std::atomic<size_t> next(0);
+	std::vector<std::thread> readers;
+	for(unsigned int t=0; t<std::min<size_t>(depth, file_names.size()); t++){
+		readers.emplace_back([&](){
+			for(size_t index=next++; index<file_names.size(); index=next++){
+				loaded_file file = {index, -1, std::vector<uint8_t>()};
+				std::ifstream in(file_names[index], std::ios::binary | std::ios::ate);
+				if(in.is_open()){
+					std::streamsize size = in.tellg();
+					// Size unknown (e.g. not a regular file), reported as unreadable
+					if(size >= 0){
+						in.seekg(0, std::ios::beg);
+						file.bytes = pool ? pool->acquire(size) : std::vector<uint8_t>();
+						file.bytes.resize(size);
+						in.read(reinterpret_cast<char*>(file.bytes.data()), size);
+						file.status = in.good() || size == 0 ? 0 : -1;
+					}
+				}
+				if(!loaded.push(std::move(file))) return;
+			}
+		});
+	}
+
+	int status = 0;
+	for(size_t i=0; i<file_names.size(); i++){
+		loaded_file file;
+		if(!loaded.pop(file)) break;
+		if(file.status < 0){
+			status = -1;
+			if(pool) pool->recycle(std::move(file.bytes));
+			on_loaded(file.index, -1, std::vector<uint8_t>());
+			continue;
+		}
+		on_loaded(file.index, 0, std::move(file.bytes));
+	}
+	loaded.close();
+	for(std::thread &reader : readers) reader.join();
+
+	return status;
+}
+
+int Decoder::DecodeFiles(const std::vector<std::string> &file_names, const ArchiveOptions &options, unsigned int threads,
+	const std::function<void(const std::string&, int, archive_file&)> &on_volume){
+	// Reads stay in flight while earlier files are decompressed and parsed
+	VolumePool volumes(options, threads, on_volume);
+	BatchLoader loader(std::max(8u, 2*resolveThreads(threads)), options.pool);
+	int status = loader.load(file_names, [&](size_t index, int loaded, std::vector<uint8_t> &&bytes){
+		// Unreadable files are still handed back (DecodeArchive fails on the empty bytes)
+		if(loaded < 0) std::cerr << "Unable to read file " << file_names[index] << std::endl;
+		volumes.submit(file_names[index], std::move(bytes));
+	});
+	volumes.finish();
+	return status;
+}
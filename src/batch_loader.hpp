@@ -0,0 +1,70 @@
+/**
+ * @file batch_loader.hpp
+ * @brief Header file for loading many files into memory with many reads in flight at once
+ * @author Owen Capell
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <functional>
+#include <cstdint>
+
+#include "buffer_pool.hpp"
+
+/**
+ * @namespace Decoder
+ * @brief Encapsulate decoding functions
+*/
+namespace Decoder
+{
+	/**
+	 * @class BatchLoader
+	 * @brief Reads whole files into memory keeping a fixed number of reads in flight, through io_uring where the kernel allows it
+	 * and otherwise through a pool of reader threads, so file reads overlap whatever the caller does with loaded files
+	*/
+	class BatchLoader{
+	private:
+		unsigned int depth;
+		bool try_io_uring;
+		bool used_io_uring;
+		std::shared_ptr<BufferPool> pool;
+
+		/**
+		 * @brief Loads the files through io_uring
+		 * @return 0 if every file loaded, -1 if any failed, -2 if io_uring is unavailable (nothing was loaded)
+		*/
+		int loadIoUring(const std::vector<std::string> &file_names, const std::function<void(size_t, int, std::vector<uint8_t>&&)> &on_loaded);
+
+		/**
+		 * @brief Loads the files on a pool of reader threads
+		 * @return 0 if every file loaded, -1 if any failed
+		*/
+		int loadThreaded(const std::vector<std::string> &file_names, const std::function<void(size_t, int, std::vector<uint8_t>&&)> &on_loaded);
+
+	public:
+		/**
+		 * @brief Constructor accepting how many reads to keep in flight
+		 * @param depth Number of files read at once (at least 1)
+		 * @param pool Buffer pool to take file buffers from (nullptr for none)
+		 * @param io_uring Whether to use io_uring when available (false always uses reader threads)
+		*/
+		explicit BatchLoader(unsigned int depth = 16, std::shared_ptr<BufferPool> pool = nullptr, bool io_uring = true);
+
+		/**
+		 * @brief Reads every file, handing each one over on the calling thread as soon as it is read (in the order reads complete)
+		 * @param file_names Names of the files to read
+		 * @param on_loaded Called with the file's index in file_names, its status (0, or -1 if it could not be read) and its bytes
+		 * @return 0 if every file loaded, -1 if any failed
+		*/
+		int load(const std::vector<std::string> &file_names, const std::function<void(size_t, int, std::vector<uint8_t>&&)> &on_loaded);
+
+		/**
+		 * @brief Tells whether the last load went through io_uring
+		 * @returns Boolean indicator of whether io_uring was used
+		*/
+		bool usedIoUring() const { return used_io_uring; }
+	};
+}
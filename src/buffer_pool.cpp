@@ -0,0 +1,79 @@
+#include <vector>
+#include <thread>
+#include <functional>
+
+#include "buffer_pool.hpp"
+#include "parallel.hpp"
+
+
+Decoder::BufferPool::BufferPool(size_t max_per_shard, size_t shards)
+	: num_shards(shards == 0 ? resolveThreads(0) : shards), max_per_shard(max_per_shard),
+	hits(0), misses(0), returns(0), discards(0){
+	this->shards = std::make_unique<shard[]>(num_shards);
+}
+
+size_t Decoder::BufferPool::home(){
+	return std::hash<std::thread::id>()(std::this_thread::get_id()) % num_shards;
+}
+
+bool Decoder::BufferPool::take(shard &from, size_t min_capacity, std::vector<uint8_t> &buffer){
+	std::lock_guard<std::mutex> guard(from.lock);
+	if(from.buffers.empty()) return false;
+
+	// Smallest buffer that fits, otherwise the largest (which is then grown)
+	size_t best = 0;
+	for(size_t i=1; i<from.buffers.size(); i++){
+		size_t cap = from.buffers[i].capacity(), best_cap = from.buffers[best].capacity();
+		bool fits = cap >= min_capacity, best_fits = best_cap >= min_capacity;
+		if((fits && (!best_fits || cap < best_cap)) || (!fits && !best_fits && cap > best_cap)) best = i;
+	}
+
+	buffer = std::move(from.buffers[best]);
+	from.buffers[best] = std::move(from.buffers.back());
+	from.buffers.pop_back();
+	return true;
+}
+
+std::vector<uint8_t> Decoder::BufferPool::acquire(size_t min_capacity){
+	std::vector<uint8_t> buffer;
+	size_t own = home();
+	for(size_t i=0; i<num_shards; i++){
+		if(take(shards[(own+i) % num_shards], min_capacity, buffer)){
+			hits++;
+			buffer.clear();
+			buffer.reserve(min_capacity);
+			return buffer;
+		}
+	}
+
+	misses++;
+	buffer.reserve(min_capacity);
+	return buffer;
+}
+
+void Decoder::BufferPool::recycle(std::vector<uint8_t> &&buffer){
+	if(buffer.capacity() == 0) return;
+
+	shard &own = shards[home()];
+	std::lock_guard<std::mutex> guard(own.lock);
+	if(own.buffers.size() >= max_per_shard){
+		discards++;
+		std::vector<uint8_t>().swap(buffer);
+		return;
+	}
+
+	returns++;
+	buffer.clear();
+	own.buffers.push_back(std::move(buffer));
+}
+
+Decoder::BufferPool::Stats Decoder::BufferPool::stats(){
+	return Stats{hits.load(), misses.load(), returns.load(), discards.load()};
+}
+
+void Decoder::BufferPool::clear(){
+	for(size_t i=0; i<num_shards; i++){
+		std::lock_guard<std::mutex> guard(shards[i].lock);
+		shards[i].buffers.clear();
+	}
+}
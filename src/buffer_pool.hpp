@@ -0,0 +1,112 @@
+/**
+ * @file buffer_pool.hpp
+ * @brief Header file for a pool of reusable byte buffers shared across archive decodes
+ * @author Owen Capell
+*/
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @namespace Decoder
+ * @brief Encapsulate decoding functions
+*/
+namespace Decoder
+{
+	/**
+	 * @class BufferPool
+	 * @brief A thread safe pool of byte buffers, so decompression output buffers keep their (warm) allocations across archives
+	 * Buffers are kept in per-thread shards; a thread that finds its own shard empty takes a buffer from another shard before allocating
+	*/
+	class BufferPool{
+	public:
+		/**
+		 * @struct Stats
+		 * @brief Counters describing how well the pool is reused
+		 * @member hits
+		 * Member 'hits' is the number of acquisitions served by a pooled buffer
+		 * @member misses
+		 * Member 'misses' is the number of acquisitions that had to allocate a new buffer
+		 * @member returns
+		 * Member 'returns' is the number of buffers given back and kept by the pool
+		 * @member discards
+		 * Member 'discards' is the number of buffers given back but freed because their shard was full
+		*/
+		struct Stats{
+			uint64_t hits;
+			uint64_t misses;
+			uint64_t returns;
+			uint64_t discards;
+		};
+
+	private:
+		typedef struct {
+			std::mutex lock;
+			std::vector<std::vector<uint8_t>> buffers;
+		} shard;
+
+		std::unique_ptr<shard[]> shards;
+		size_t num_shards;
+		size_t max_per_shard;
+		std::atomic<uint64_t> hits;
+		std::atomic<uint64_t> misses;
+		std::atomic<uint64_t> returns;
+		std::atomic<uint64_t> discards;
+
+		/**
+		 * @brief Tells which shard belongs to the calling thread
+		 * @return Index of the calling thread's shard
+		*/
+		size_t home();
+
+		/**
+		 * @brief Takes the best fitting buffer out of a shard
+		 * @param from Shard to take from
+		 * @param min_capacity Capacity the caller needs
+		 * @param buffer Reference to store the taken buffer in
+		 * @return Boolean indicator of whether a buffer was taken
+		*/
+		bool take(shard &from, size_t min_capacity, std::vector<uint8_t> &buffer);
+
+	public:
+		/**
+		 * @brief Constructor accepting the pool bounds
+		 * @param max_per_shard Maximum number of idle buffers kept for each thread shard
+		 * @param shards Number of thread shards (0 for one per hardware core)
+		*/
+		explicit BufferPool(size_t max_per_shard = 8, size_t shards = 0);
+
+		BufferPool(const BufferPool&) = delete;
+		BufferPool& operator=(const BufferPool&) = delete;
+
+		/**
+		 * @brief Hands out an empty buffer, reusing an idle one when possible
+		 * @param min_capacity Capacity to reserve in the returned buffer
+		 * @return Empty buffer with at least min_capacity bytes reserved
+		*/
+		std::vector<uint8_t> acquire(size_t min_capacity = 0);
+
+		/**
+		 * @brief Gives a buffer back to the pool for reuse
+		 * @param buffer Buffer to give back (its contents are discarded)
+		*/
+		void recycle(std::vector<uint8_t> &&buffer);
+
+		/**
+		 * @brief Tells the reuse counters of the pool
+		 * @return Snapshot of the counters
+		*/
+		Stats stats();
+
+		/**
+		 * @brief Frees every idle buffer held by the pool
+		*/
+		void clear();
+	};
+}
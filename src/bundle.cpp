@@ -0,0 +1,136 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <functional>
+
+#include <zlib.h>
+
+#include "decoder.hpp"
+#include "lvltwodef.hpp"
+#include "volume_pool.hpp"
+
+
+/**
+ * @brief Reads exactly the given number of bytes from a (possibly Gzip compressed) stream
+ * @return Boolean indicator of whether all bytes were read
+*/
+static bool readExact(gzFile in, uint8_t *buffer, uint64_t size){
+	while(size > 0){
+		unsigned int amt = static_cast<unsigned int>(std::min<uint64_t>(size, GZIP_READ_BUFSIZE));
+		if(gzread(in, buffer, amt) != static_cast<int>(amt)) return false;
+		buffer += amt;
+		size -= amt;
+	}
+	return true;
+}
+
+/**
+ * @brief Parses a numeric tar header field (octal text, or base-256 when the high bit of the first byte is set)
+*/
+static uint64_t tarNumber(const uint8_t *field, size_t width){
+	uint64_t value = 0;
+	if(field[0] & 0x80){
+		value = field[0] & 0x7F;
+		for(size_t i=1; i<width; i++) value = (value << 8) | field[i];
+		return value;
+	}
+	// Older writers pad with leading spaces (or NULs) rather than zeros
+	size_t i = 0;
+	while(i < width && (field[i] == ' ' || field[i] == '\0')) i++;
+	for(; i<width && field[i] >= '0' && field[i] <= '7'; i++) value = (value << 3) | (field[i] - '0');
+	return value;
+}
+
+/**
+ * @brief Tells whether a tar header block matches its checksum (the sum of all bytes, counting the checksum field as spaces)
+*/
+static bool tarChecksumValid(const uint8_t *header){
+	uint64_t sum = 0;
+	for(size_t i=0; i<TAR_BLOCK_SIZE; i++) sum += (i >= 148 && i < 156) ? ' ' : header[i];
+	return sum == tarNumber(header+148, 8);
+}
+
+int Decoder::DecodeBundle(const std::string &bundle_name, const ArchiveOptions &options, unsigned int threads,
+	const std::function<void(const std::string&, int, archive_file&)> &on_volume){
+	// zlib reads plain tar files through transparently, so .tar and .tar.gz share one reader
+	gzFile in = gzopen(bundle_name.c_str(), "rb");
+	if(in == nullptr){
+		std::cerr << "Unable to open file " << bundle_name << std::endl;
+		return -1;
+	}
+	gzbuffer(in, GZIP_READ_BUFSIZE);
+
+	// Members are decoded on a pool of workers as soon as they are read
+	VolumePool volumes(options, threads, on_volume);
+
+	int status = 0;
+	std::string long_name;
+	uint8_t header[TAR_BLOCK_SIZE];
+	while(true){
+		if(!readExact(in, header, TAR_BLOCK_SIZE)){
+			std::cerr << "Unexpected EOF in tar bundle " << bundle_name << std::endl;
+			status = -1;
+			break;
+		}
+
+		// A zeroed block marks the end of the bundle
+		bool zeroed = true;
+		for(size_t i=0; i<TAR_BLOCK_SIZE && zeroed; i++) zeroed = header[i] == 0;
+		if(zeroed) break;
+
+		if(!tarChecksumValid(header)){
+			std::cerr << "Malformed tar header in bundle " << bundle_name << std::endl;
+			status = -1;
+			break;
+		}
+
+		uint64_t size = tarNumber(header+124, 12);
+		uint64_t padding = (TAR_BLOCK_SIZE - size % TAR_BLOCK_SIZE) % TAR_BLOCK_SIZE;
+		char type = static_cast<char>(header[156]);
+
+		// GNU long name, applying to the next member
+		if(type == 'L'){
+			std::vector<uint8_t> name(size + padding);
+			if(!readExact(in, name.data(), name.size())){
+				status = -1;
+				break;
+			}
+			long_name.assign(reinterpret_cast<const char*>(name.data()), strnlen(reinterpret_cast<const char*>(name.data()), size));
+			continue;
+		}
+
+		// Only regular files hold archives, skip directories, links and extended headers
+		if(type != '0' && type != '\0' && type != '7'){
+			if(gzseek(in, size + padding, SEEK_CUR) < 0){
+				status = -1;
+				break;
+			}
+			long_name.clear();
+			continue;
+		}
+
+		std::string member_name;
+		if(!long_name.empty()) member_name = std::move(long_name);
+		else{
+			std::string prefix(reinterpret_cast<const char*>(header+345), strnlen(reinterpret_cast<const char*>(header+345), 155));
+			std::string name(reinterpret_cast<const char*>(header), strnlen(reinterpret_cast<const char*>(header), 100));
+			member_name = prefix.empty() ? name : prefix + "/" + name;
+		}
+		long_name.clear();
+
+		std::vector<uint8_t> bytes = options.pool ? options.pool->acquire(size) : std::vector<uint8_t>();
+		bytes.resize(size);
+		if(!readExact(in, bytes.data(), size) || gzseek(in, padding, SEEK_CUR) < 0){
+			std::cerr << "Unexpected EOF in tar bundle member " << member_name << std::endl;
+			status = -1;
+			break;
+		}
+
+		volumes.submit(std::move(member_name), std::move(bytes));
+	}
+	gzclose(in);
+
+	volumes.finish();
+	return status;
+}
@@ -0,0 +1,119 @@
+#include <cstdint>
+#include <cstddef>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define OPENREFLECTIVITY_X86_KERNELS 1
+#endif
+
+#include "byte_swap.hpp"
+
+
+/**
+ * @brief Swaps every word of an array one at a time (also finishes the tail the vector kernels leave)
+*/
+template <typename T>
+static void reverseScalar(T *words, size_t count){
+	for(size_t i=0; i<count; i++) words[i] = Decoder::reverseEndian(words[i]);
+}
+
+#ifdef OPENREFLECTIVITY_X86_KERNELS
+/**
+ * @brief Swaps 16 bytes at a time with a byte shuffle
+ * @param words Pointer to the words
+ * @param bytes Number of bytes to swap (the tail past the last whole vector is left alone)
+ * @param order Shuffle reversing the bytes of each word within a 16-byte lane
+ * @return Number of bytes swapped
+*/
+__attribute__((target("ssse3")))
+static size_t reverseSsse3(uint8_t *words, size_t bytes, const uint8_t *order){
+	const __m128i shuffle = _mm_loadu_si128(reinterpret_cast<const __m128i*>(order));
+	size_t i = 0;
+	for(; i+16 <= bytes; i+=16){
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words+i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(words+i), _mm_shuffle_epi8(v, shuffle));
+	}
+	return i;
+}
+
+/**
+ * @brief Swaps 32 bytes at a time with a byte shuffle (the shuffle works within each 16-byte lane, so the order repeats)
+ * @param words Pointer to the words
+ * @param bytes Number of bytes to swap (the tail past the last whole vector is left alone)
+ * @param order Shuffle reversing the bytes of each word within a 16-byte lane
+ * @return Number of bytes swapped
+*/
+__attribute__((target("avx2")))
+static size_t reverseAvx2(uint8_t *words, size_t bytes, const uint8_t *order){
+	const __m256i shuffle = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(order)));
+	size_t i = 0;
+	// Two vectors per iteration keep both load ports busy
+	for(; i+64 <= bytes; i+=64){
+		__m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words+i));
+		__m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words+i+32));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(words+i), _mm256_shuffle_epi8(a, shuffle));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(words+i+32), _mm256_shuffle_epi8(b, shuffle));
+	}
+	for(; i+32 <= bytes; i+=32){
+		__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words+i));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(words+i), _mm256_shuffle_epi8(v, shuffle));
+	}
+	return i;
+}
+
+enum class Kernel { SCALAR, SSSE3, AVX2 };
+
+/**
+ * @brief Picks the widest kernel the CPU supports (checked once)
+*/
+static Kernel detectKernel(){
+	static const Kernel kernel = [](){
+		__builtin_cpu_init();
+		if(__builtin_cpu_supports("avx2")) return Kernel::AVX2;
+		if(__builtin_cpu_supports("ssse3")) return Kernel::SSSE3;
+		return Kernel::SCALAR;
+	}();
+	return kernel;
+}
+
+/**
+ * @brief Runs the widest kernel over whole vectors of an array
+ * @return Number of bytes swapped (the rest is left to the scalar loop)
+*/
+static size_t reverseVector(uint8_t *words, size_t bytes, const uint8_t *order){
+	switch(detectKernel()){
+		case Kernel::AVX2: return reverseAvx2(words, bytes, order);
+		case Kernel::SSSE3: return reverseSsse3(words, bytes, order);
+		default: return 0;
+	}
+}
+#endif
+
+void Decoder::reverseEndian16(uint16_t *words, size_t count){
+	size_t done = 0;
+#ifdef OPENREFLECTIVITY_X86_KERNELS
+	static const uint8_t order[16] = {1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14};
+	done = reverseVector(reinterpret_cast<uint8_t*>(words), count*sizeof(uint16_t), order) / sizeof(uint16_t);
+#endif
+	reverseScalar(words+done, count-done);
+}
+
+void Decoder::reverseEndian32(uint32_t *words, size_t count){
+	size_t done = 0;
+#ifdef OPENREFLECTIVITY_X86_KERNELS
+	static const uint8_t order[16] = {3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12};
+	done = reverseVector(reinterpret_cast<uint8_t*>(words), count*sizeof(uint32_t), order) / sizeof(uint32_t);
+#endif
+	reverseScalar(words+done, count-done);
+}
+
+const char* Decoder::byteSwapKernel(){
+#ifdef OPENREFLECTIVITY_X86_KERNELS
+	switch(detectKernel()){
+		case Kernel::AVX2: return "avx2";
+		case Kernel::SSSE3: return "ssse3";
+		default: break;
+	}
+#endif
+	return "scalar";
+}
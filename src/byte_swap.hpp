@@ -0,0 +1,65 @@
+/**
+ * @file byte_swap.hpp
+ * @brief Header file for scalar and batch byte swapping between big endian archive data and the host
+ * @author Owen Capell
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+/**
+ * @namespace Decoder
+ * @brief Encapsulate decoding functions
+*/
+namespace Decoder
+{
+	/**
+	 * @brief Reverses the endianness of an arbitrary integral type (a single byte swap instruction on GCC and Clang)
+	 * @tparam T	The integral datatype to reverse
+	 * @param data	Reference to the data for which the endianness should be reversed
+	 * @return	Copy of data with endianness reveresed
+	*/
+	template <typename T>
+	constexpr T reverseEndian(const T& data){
+		static_assert(std::is_integral<T>::value, "Only integral types have their endianness reversed");
+		typedef std::make_unsigned_t<T> U;
+		U bits = static_cast<U>(data);
+
+		if constexpr(sizeof(T) == 1) return data;
+#if defined(__GNUC__) || defined(__clang__)
+		else if constexpr(sizeof(T) == 2) return static_cast<T>(__builtin_bswap16(bits));
+		else if constexpr(sizeof(T) == 4) return static_cast<T>(__builtin_bswap32(bits));
+		else if constexpr(sizeof(T) == 8) return static_cast<T>(__builtin_bswap64(bits));
+#endif
+		else{
+			U reverse_endian = 0;
+			for(size_t i=0; i<sizeof(T); i++){
+				reverse_endian = static_cast<U>((reverse_endian << 8) | ((bits >> (8 * i)) & 0xFF));
+			}
+			return static_cast<T>(reverse_endian);
+		}
+	}
+
+	/**
+	 * @brief Reverses the endianness of every 16-bit word of an array in place (AVX2 or SSSE3 when the CPU has them), e.g. 16-bit moment gates
+	 * @param words Pointer to the words (no alignment needed)
+	 * @param count Number of words
+	*/
+	void reverseEndian16(uint16_t *words, size_t count);
+
+	/**
+	 * @brief Reverses the endianness of every 32-bit word of an array in place (AVX2 or SSSE3 when the CPU has them), e.g. bulk header arrays
+	 * @param words Pointer to the words (no alignment needed)
+	 * @param count Number of words
+	*/
+	void reverseEndian32(uint32_t *words, size_t count);
+
+	/**
+	 * @brief Names the batch byte swap kernel this CPU runs
+	 * @return "avx2", "ssse3" or "scalar"
+	*/
+	const char* byteSwapKernel();
+}
@@ -0,0 +1,85 @@
+#include <iostream>
+#include <memory>
+#include <functional>
+
+#include "decoder.hpp"
+#include "lvltwodef.hpp"
+
+
+Decoder::ChunkDecoder::ChunkDecoder(archive_file &file, std::function<void(const std::shared_ptr<elevation_head>&)> on_elevation,
+	const ArchiveOptions &options) : archive(options), file(file), on_elevation(std::move(on_elevation)){
+	published.fill(false);
+	header_decoded = false;
+	metadata_decoded = false;
+	volume_complete = false;
+	file.scan_elevations.fill(nullptr);
+}
+
+void Decoder::ChunkDecoder::publishElevations(){
+	for(size_t i=0; i<file.scan_elevations.size(); i++){
+		std::shared_ptr<elevation_head> elevation = file.scan_elevations[i];
+		if(published[i] || elevation == nullptr || elevation->radials.empty()) continue;
+
+		uint16_t status = elevation->radials.back()->radial_status;
+		if(status != RADIAL_STATUS_END_ELEVATION && status != RADIAL_STATUS_END_VOLUME) continue;
+
+		published[i] = true;
+		if(status == RADIAL_STATUS_END_VOLUME) volume_complete = true;
+		if(on_elevation) on_elevation(elevation);
+	}
+}
+
+int Decoder::ChunkDecoder::push(const uint8_t *chunk, size_t size){
+	if(archive.append(chunk, size) < 0) return -1;
+	return decodeAvailable();
+}
+
+int Decoder::ChunkDecoder::push(std::vector<uint8_t> &&decompressed){
+	if(archive.append(std::move(decompressed)) < 0) return -1;
+	return decodeAvailable();
+}
+
+int Decoder::ChunkDecoder::push(RecordCache::Entry &&cached){
+	if(archive.append(std::move(cached)) < 0) return -1;
+	return decodeAvailable();
+}
+
+int Decoder::ChunkDecoder::decodeAvailable(){
+	// Start chunk carries the volume header followed by the metadata record
+	if(!header_decoded){
+		if(archive.size() < VOLUME_HEADER_SIZE) return 0;
+		file.header = std::make_unique<volume_header>();
+		if(Decoder::DecodeHeader(archive, file.header) < 0) return -1;
+		header_decoded = true;
+	}
+
+	if(!metadata_decoded){
+		if(archive.size() - archive.position() < METADATA_RECORD_SIZE) return 0;
+		file.metadata = std::make_unique<metadata_record>();
+		if(Decoder::DecodeMetadata(archive, file.metadata) < 0) return -1;
+		metadata_decoded = true;
+	}
+
+	// Decode every message completed by this chunk
+	if(!archive.at_end()){
+		int status = Decoder::DecodeMessages(archive, file);
+		if(status < 0) return status;
+	}
+
+	publishElevations();
+
+	// Decoded bytes are never read again
+	archive.release();
+	return 0;
+}
+
+int Decoder::ChunkDecoder::finish(){
+	file.bad_records = archive.badRecords();
+	file.partial = !file.bad_records.empty();
+	if(!header_decoded || !metadata_decoded) return -1;
+	if(!archive.at_end()){
+		std::cerr << "Unexpected non-EOF. Decode attempt success unknown. Archive file may be corrupt." << std::endl;
+		return -2;
+	}
+	return 0;
+}
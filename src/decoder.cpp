@@ -4,7 +4,9 @@
 #include <iomanip>
 #include <memory>
 #include <cstdlib>
+#include <cstring>
 #include <vector>
+#include <algorithm>
 
 #include <zlib.h>
 #include <bzlib.h>
@@ -29,11 +31,18 @@ int Decoder::DecodeHeader(ArchiveFile &archive, std::unique_ptr<volume_header> &
 	version_raw[2] = '\0';
 	// skip "."
 	archive.ignore(1);
-	uint8_t version = static_cast<uint8_t>(std::stoi(version_raw));
 
 	char ext_num_raw[4];
 	archive.read(ext_num_raw, 3);
 	ext_num_raw[3] = '\0';
+
+	// Version and extension number are digits, anything else is a damaged header (and would make std::stoi throw)
+	auto digits = [](const char *text){ return std::all_of(text, text+std::strlen(text), [](char c){ return c >= '0' && c <= '9'; }) && text[0] != '\0'; };
+	if(!digits(version_raw) || !digits(ext_num_raw)){
+		std::cerr << "Malformed volume header version or extension number." << std::endl;
+		return -1;
+	}
+	uint8_t version = static_cast<uint8_t>(std::stoi(version_raw));
 	uint8_t ext_num = static_cast<uint8_t>(std::stoi(ext_num_raw));
 
 	uint32_t date;
@@ -70,198 +79,302 @@ int Decoder::DecodeMetadata(ArchiveFile &archive, std::unique_ptr<metadata_recor
 	return 0;
 }
 
+int Decoder::ReadMessageHeader(ArchiveFile &archive, message_header_layout &header, uint64_t &message_end){
+	uint64_t frame_start_pos = archive.position();
+
+	// Skip 12 bytes of zeros prepended to all messages (still don't get this)
+	archive.ignore(MESSAGE_PREFIX_SIZE);
+
+	uint64_t message_start_pos = archive.position();
+	if(archive.readLayout(header) < sizeof(header)){
+		archive.seek(frame_start_pos);
+		return 1;
+	}
+
+	// Case where message size > 65534 halfwords
+	uint32_t message_size = (header.message_size.get() == 65535)
+		? (static_cast<uint32_t>(header.segment_count.get()) << 16) | header.segment_num.get()
+		: header.message_size.get()*2; // multiply 2 for halfword->byte conversion
+
+	// Only Message 31 is variable length, all other messages occupy a fixed size frame
+	message_end = (header.message_type.get() == MESSAGE_TYPE_31)
+		? message_start_pos + message_size
+		: frame_start_pos + MESSAGE_FRAME_SIZE;
+	if(message_end < message_start_pos + sizeof(header)){
+		archive.seek(frame_start_pos);
+		return -1;
+	}
+
+	// Incomplete message
+	if(message_end > archive.size()){
+		archive.seek(frame_start_pos);
+		return 1;
+	}
+	return 0;
+}
+
 int Decoder::DecodeMessages(ArchiveFile &archive, archive_file &file){
 	if(archive.at_end()){
-		std::cerr << "Unexpected EOF. Archive is header only." << std::endl;
+		file.diagnostics.report(DiagnosticCode::HEADER_ONLY);
 		return -1;
 	}
 
 	// Parse messages until EOF
-	uint64_t message_qty = 0;
 	while(!archive.at_end()){
-		message_qty++;
-		// Skip 12 bytes of zeros prepended to all messages (still don't get this)
-		if(!archive.ignore(12))
-			return 0; // I don't think this is an error atm (or even possible)
-		
-		uint64_t message_start_pos = archive.position();
-		uint32_t message_size;
-		uint16_t message_size_read;
-		uint8_t rda_channel, message_type;
-		if((archive.readIntegral(message_size_read)<2)
-			|| (archive.readIntegral(rda_channel)<1)
-			|| (archive.readIntegral(message_type)<1)
-			|| (!archive.ignore(8))){
-			std::cerr << "Error parsing message header: Message #" << message_qty << std::endl;
+		uint64_t frame_start_pos = archive.position();
+
+		// Incomplete message header (more data may still be appended), leave it for the next call
+		if(archive.size() - frame_start_pos < MESSAGE_PREFIX_SIZE + MESSAGE_HEADER_SIZE)
+			return 0;
+
+		message_header_layout header;
+		uint64_t message_end_pos;
+		int status = Decoder::ReadMessageHeader(archive, header, message_end_pos);
+		// Incomplete message, leave it for the next call
+		if(status > 0) return 0;
+		// Chunked decodes release parsed bytes, so offsets are reported from the start of the volume instead
+		file.diagnostics.beginMessage(archive.releasedBytes() + frame_start_pos);
+		if(status < 0){
+			file.diagnostics.report(DiagnosticCode::MALFORMED_MESSAGE_HEADER);
 			return -1;
-		}	
-
-		// Case where message size > 65534 halfwords 
-		if(message_size_read == 65535){
-			uint16_t most_sig_halfword, least_sig_halfword;
-			archive.readIntegral(most_sig_halfword);
-			archive.readIntegral(least_sig_halfword);
-			message_size = (most_sig_halfword << 16) | least_sig_halfword;
 		}
-		else
-		 	// When message size <= 65534 halfwords, messege seg fields both set to 1
-			message_size = message_size_read*2; // multiply 2 for halfword->byte conversion
-			// confirming
-			uint16_t message_seg1, message_seg2;
-			archive.readIntegral(message_seg1);
-			archive.readIntegral(message_seg2);
-			if(!(message_seg1 == 1 && message_seg2 == 1)){
-				std::cerr << "Message with less than 65534 halfwords has improper message segment fields." << std::endl;
-			}
+		uint8_t message_type = header.message_type.get();
+
+		// When message size <= 65534 halfwords, messege seg fields both set to 1
+		if(header.message_size.get() != 65535 && !(header.segment_count.get() == 1 && header.segment_num.get() == 1)){
+			file.diagnostics.report(DiagnosticCode::IMPROPER_SEGMENT_FIELDS);
+		}
 
 		switch(message_type){
-			case MESSAGE_TYPE_31:
-			 	if(Decoder::Message31::ParseMessage31(archive, file) < 0) return -31;
+			case MESSAGE_TYPE_31:{
+				// Message extent is known from its header, so it is bounds checked once here rather than on every read
+				uint64_t begin_header_pos = frame_start_pos + MESSAGE_PREFIX_SIZE + MESSAGE_HEADER_SIZE;
+				MessageCursor cursor(archive.view(begin_header_pos, message_end_pos - begin_header_pos));
+			 	if(Decoder::Message31::ParseMessage31(cursor, file) < 0) return -31;
 				break;
+			}
 
 			default:
 			 	// unsupported message
-				// std::cerr << "Message Type: " << static_cast<int>(message_type) << " not handled (Message # " << message_qty 
+				// std::cerr << "Message Type: " << static_cast<int>(message_type) << " not handled (Message # " << file.diagnostics.messageCount() 
 					// << ")" << std::endl;
 				break;
 		}
 
-		archive.seek(message_start_pos+message_size);
+		archive.seek(message_end_pos);
 	}
 
 	return 0;
 }
 
 int Decoder::Message31::ParseMessage31(ArchiveFile &archive, archive_file &file){
+	// Message header precedes the Message 31 header and gives its extent
 	uint64_t begin_header_pos = archive.position();
+	message_header_layout message_header;
+	uint64_t message_end;
+	if(begin_header_pos < MESSAGE_PREFIX_SIZE + MESSAGE_HEADER_SIZE
+		|| !archive.seek(begin_header_pos - MESSAGE_HEADER_SIZE - MESSAGE_PREFIX_SIZE)
+		|| Decoder::ReadMessageHeader(archive, message_header, message_end) != 0){
+		archive.seek(begin_header_pos);
+		file.diagnostics.report(DiagnosticCode::MALFORMED_MESSAGE_HEADER);
+		return -1;
+	}
 
-	/* Parse Message31 Header, ignoring fields not used currently*/
-	archive.ignore(10);
-	
-	uint16_t azimuth_num;
-	float azimuth_angle;
-	
-	archive.readIntegral(azimuth_num);
-	archive.readFloat(azimuth_angle);
-
-	archive.ignore(2);
-	uint32_t ptr_vol_const, ptr_elv_const, ptr_rad_const, ptr_ref_block, ptr_vel_block;
-	uint16_t radial_length, radial_length_nh, data_block_count;
-	uint8_t elevation_num;
-	float elevation_ang;
-
-	archive.readIntegral(radial_length);
-	archive.ignore(2);
-	archive.readIntegral(elevation_num);
-	archive.ignore(1);
-	archive.readFloat(elevation_ang);
-	archive.ignore(2);
-	archive.readIntegral(data_block_count);
-	archive.readIntegral(ptr_vol_const);
-	archive.readIntegral(ptr_elv_const);
-	archive.readIntegral(ptr_rad_const);
-	archive.readIntegral(ptr_ref_block);
-	// archive.readIntegral(ptr_vel_block);
-
-	if(file.scan_elevations[elevation_num]==nullptr)
-		file.scan_elevations[elevation_num] = std::make_shared<elevation_head>();
-	std::shared_ptr<elevation_head> elevation = file.scan_elevations[elevation_num];
-	elevation->elevation = elevation_ang;
-	elevation->elevation_num = elevation_num;
+	MessageCursor cursor(archive.view(begin_header_pos, message_end - begin_header_pos));
+	int status = Decoder::Message31::ParseMessage31(cursor, file);
+	archive.seek(message_end);
+	return status;
+}
+
+int Decoder::Message31::ParseMessage31(MessageCursor &cursor, archive_file &file){
+	radial_view view;
+	if(Decoder::Message31::ReadRadial(cursor, view, file.diagnostics) < 0) return -1;
+	if(view.elevation_num >= file.scan_elevations.size()){
+		file.diagnostics.report(DiagnosticCode::ELEVATION_OUT_OF_RANGE);
+		return -1;
+	}
+
+	if(file.scan_elevations[view.elevation_num]==nullptr)
+		file.scan_elevations[view.elevation_num] = std::make_shared<elevation_head>();
+	std::shared_ptr<elevation_head> elevation = file.scan_elevations[view.elevation_num];
+	elevation->elevation = view.elevation;
+	elevation->elevation_num = view.elevation_num;
 
 	// Message 31 is one radial with many products... parse them
 	std::shared_ptr<radial_data> cur_radial = std::make_shared<radial_data>();
-	cur_radial->azimuth = azimuth_angle;
-	cur_radial->azimuth_num = azimuth_num;
-	cur_radial->num_data_blocks = data_block_count;
-	cur_radial->ptr_vol_const = ptr_vol_const;
-	cur_radial->ptr_elv_const = ptr_elv_const;
-	cur_radial->ptr_rad_const = ptr_rad_const;
-	cur_radial->ptr_ref_block = ptr_ref_block;
-	Decoder::Message31::ParseRadial(archive, cur_radial, begin_header_pos);
+	cur_radial->azimuth = view.azimuth;
+	cur_radial->azimuth_num = view.azimuth_num;
+	cur_radial->radial_length = view.radial_length;
+	cur_radial->radial_status = view.radial_status;
+	cur_radial->azimuth_spacing = view.azimuth_spacing;
+	cur_radial->num_data_blocks = view.num_data_blocks;
+	cur_radial->ptr_vol_const = view.ptr_vol_const;
+	cur_radial->ptr_elv_const = view.ptr_elv_const;
+	cur_radial->ptr_rad_const = view.ptr_rad_const;
+	cur_radial->ptr_ref_block = view.ptr_ref_block;
+	if(view.ref.gates != nullptr) Decoder::Message31::ParseRadial(view.ref, cur_radial);
 	elevation->radials.push_back(cur_radial);
 
 	return 0;
 }
 
-int Decoder::Message31::ParseRadial(ArchiveFile &archive, std::shared_ptr<radial_data> &cur_radial, uint64_t begin_header_pos){
+int Decoder::Message31::ReadRadial(MessageCursor &cursor, radial_view &view, Diagnostics &diagnostics){
+	/* Parse Message31 Header, ignoring fields not used currently*/
+	message31_header_layout header;
+	if(!cursor.fits(0, sizeof(header))){
+		diagnostics.report(DiagnosticCode::MESSAGE_31_TOO_SHORT);
+		return -1;
+	}
+	cursor.seek(0);
+	cursor.readLayout(header);
+
+	view.azimuth = header.azimuth_angle.get();
+	view.azimuth_num = header.azimuth_num.get();
+	view.elevation = header.elevation_angle.get();
+	view.elevation_num = header.elevation_num.get();
+	view.radial_length = header.radial_length.get();
+	view.radial_status = header.radial_status.get();
+	view.num_data_blocks = header.data_block_count.get();
+	view.ptr_vol_const = header.ptr_vol_const.get();
+	view.ptr_elv_const = header.ptr_elv_const.get();
+	view.ptr_rad_const = header.ptr_rad_const.get();
+	view.ptr_ref_block = header.ptr_ref_block.get();
+	view.azimuth_spacing = (header.azimuth_spacing.get() == 2);
+	view.offset = 0;
+
+	// A radial with an unreadable REF block is still a radial, just without reflectivity
+	if(Decoder::Message31::ReadReflectivity(cursor, view.ptr_ref_block, view.ref, diagnostics) < 0) view.ref.gates = nullptr;
+	return 0;
+}
+
+int Decoder::Message31::ReadReflectivity(MessageCursor &cursor, uint32_t block_ptr, moment_view &ref, Diagnostics &diagnostics){
 	/* Currently only parsing reflectivity! */
 
-	// REF
-	archive.seek(begin_header_pos+cur_radial->ptr_ref_block);
-	char type_name[5];
-	archive.read(type_name, 4);
-	type_name[4] = '\0';
-	if(std::string(type_name) != "DREF"){
-		std::cerr << "Unable to find \"DREF\" indicator in REF data block." << std::endl; 
+	// REF (block pointers are relative to the Message 31 header, where the cursor starts)
+	moment_block_layout block;
+	if(!cursor.fits(block_ptr, sizeof(block))){
+		diagnostics.report(DiagnosticCode::REF_BLOCK_TRUNCATED);
+		return -1;
+	}
+	cursor.seek(block_ptr);
+	cursor.readLayout(block);
+	if(std::memcmp(block.type_name, "DREF", 4) != 0){
+		diagnostics.report(DiagnosticCode::MISSING_DREF);
 		return -1;
 	}
 
-	// Reserved
-	archive.ignore(4);
-
-	uint16_t num_gates, range_raw, interval_raw, tover_raw;
-	short snr_raw;
-	float range, interval, tover, snr;
-	archive.readIntegral(num_gates);
-	archive.readIntegral(range_raw);
-	archive.readIntegral(interval_raw);
-	archive.readIntegral(tover_raw);
-	archive.readIntegral(snr_raw);
+	ref.num_gates = block.num_gates.get();
 	// Scaled (unsigned) integers with 0.001 precision
-	range = ((float) range_raw) / 1000;
-	interval = ((float) interval_raw) / 1000;
-	tover = ((float) tover_raw) / 10; // 0.1 precision
-	snr = ((float) snr_raw) / 8; // 0.125 precision
-	archive.ignore(1); // control flags
-
-	uint8_t data_word_size;
-	float scale, offset;
-	archive.readIntegral(data_word_size);
-	if(data_word_size != 8){
-		std::cerr << "Improper moment word size for REF: (Expected: 8 but got: " << data_word_size << ")" << std::endl;
+	ref.range = ((float) block.range.get()) / 1000;
+	ref.range_interval = ((float) block.range_interval.get()) / 1000;
+	ref.snr = ((float) block.snr_threshold.get()) / 8; // 0.125 precision
+
+	ref.word_size = block.word_size.get();
+	if(ref.word_size != 8 && ref.word_size != 16){
+		diagnostics.report(DiagnosticCode::IMPROPER_WORD_SIZE);
 		return -1;
 	}
-	archive.readFloat(scale);
-	archive.readFloat(offset);
+	ref.scale = block.scale.get();
+	ref.offset = block.offset.get();
+
+	// Gates are checked once, then viewed in place
+	size_t gate_bytes = static_cast<size_t>(ref.num_gates) * (ref.word_size / 8);
+	if(!cursor.fits(cursor.position(), gate_bytes)){
+		diagnostics.report(DiagnosticCode::GATES_TRUNCATED);
+		return -1;
+	}
+	ref.gates = cursor.take(gate_bytes);
+	return 0;
+}
+
+int Decoder::Message31::ParseRadial(const moment_view &ref, std::shared_ptr<radial_data> &cur_radial){
+	uint16_t num_gates = ref.num_gates;
+	const uint8_t *gates = ref.gates;
+	float scale = ref.scale;
+	float offset = ref.offset;
 
 	cur_radial->ref = std::make_unique<radial>();
 	cur_radial->ref->moment = MomentType::REF;
 	cur_radial->ref->num_gates = num_gates;
-	cur_radial->ref->range = range;
-	cur_radial->ref->range_interval = interval;
-	cur_radial->ref->snr = snr;
-	cur_radial->ref->word_size = data_word_size;
+	cur_radial->ref->range = ref.range;
+	cur_radial->ref->range_interval = ref.range_interval;
+	cur_radial->ref->snr = ref.snr;
+	cur_radial->ref->word_size = ref.word_size;
 	cur_radial->ref->scale = scale;
 	cur_radial->ref->offset = offset;
 
 	/* Lambda for converting recorded REF to actual REF */
-	auto record_to_true = [scale, offset](uint8_t recorded) { return (((float)recorded) + offset) / scale; };
+	auto record_to_true = [scale, offset](uint16_t recorded) { return (((float)recorded) + offset) / scale; };
 	
-	uint8_t gate;
+	cur_radial->ref->data.reserve(num_gates);
+	if(ref.word_size == 16){
+		// 16-bit gates are big endian, so the whole radial is swapped in one batch (reused per thread) before converting
+		thread_local std::vector<uint16_t> words;
+		words.resize(num_gates);
+		std::memcpy(words.data(), gates, static_cast<size_t>(num_gates) * sizeof(uint16_t));
+		Decoder::reverseEndian16(words.data(), words.size());
+		for(uint16_t word : words)
+			(!(word == 0 || word == 1)) ? cur_radial->ref->data.push_back(record_to_true(word)) : cur_radial->ref->data.push_back(0);
+		return 0;
+	}
+
 	for(uint16_t i=0; i<num_gates; i++){
-		archive.readIntegral(gate);
+		uint8_t gate = gates[i];
 		// 0 is below snr, 1 is range folding
 		(!(gate == 0 || gate == 1)) ? cur_radial->ref->data.push_back(record_to_true(gate)) : cur_radial->ref->data.push_back(0);
 	}
 
-	if(num_gates != cur_radial->ref->data.size()){
-		std::cerr << "Discrepancy between number of expected gates (" << num_gates
-			<< ") and number of recorded gates(" << cur_radial->ref->data.size() << ")" << std::endl;
-		return -1;
-	}
-
 	return 0;
 }
 
 int Decoder::DecodeArchive(const std::string &file_name, const bool &dump, archive_file &file){
-	Decoder::ArchiveFile archive(file_name);
+	return Decoder::DecodeArchive(file_name, dump, file, ArchiveOptions{});
+}
+
+int Decoder::DecodeArchive(const std::string &file_name, const bool &dump, archive_file &file, const ArchiveOptions &options){
+	// Pipelining (and lazily decoding requested elevations) never holds the whole decompressed archive, so it cannot be dumped
+	if((options.pipeline_depth > 0 || !options.elevations.empty()) && !dump){
+		std::vector<uint8_t> post_gzip;
+		if(ArchiveFile::decompressGzip(file_name, post_gzip, options.gzip, options.pool.get()) < 0){
+			std::cerr << "Unable to read archive file." << std::endl;
+			return -1;
+		}
+		return Decoder::DecodePipelined(post_gzip.data(), post_gzip.size(), file, options);
+	}
+
+	Decoder::ArchiveFile archive(file_name, options);
 	
 	if(dump){
 	 	std::string dump_name = "DECOMP_" + file_name;
 		archive.dump_to_file(dump_name);
 	}
 
+	return Decoder::DecodeArchive(archive, file);
+}
+
+int Decoder::DecodeArchive(const uint8_t *bytes, size_t size, archive_file &file, const ArchiveOptions &options){
+	if(options.pipeline_depth > 0 || !options.elevations.empty()){
+		if(options.gzip && size >= GZIP_MIN_SIZE && bytes[0] == 0x1f && bytes[1] == 0x8b){
+			std::vector<uint8_t> post_gzip;
+			if(ArchiveFile::decompressGzip(bytes, size, post_gzip, options.pool.get()) < 0){
+				std::cerr << "Unable to decompress archive file." << std::endl;
+				return -1;
+			}
+			return Decoder::DecodePipelined(post_gzip.data(), post_gzip.size(), file, options);
+		}
+		return Decoder::DecodePipelined(bytes, size, file, options);
+	}
+
+	Decoder::ArchiveFile archive(bytes, size, options);
+	return Decoder::DecodeArchive(archive, file);
+}
+
+int Decoder::DecodeArchive(ArchiveFile &archive, archive_file &file){
+	if(!archive.isInitialized()){
+		std::cerr << "Unable to decompress archive file." << std::endl;
+		return -1;
+	}
+
 	// Parse volume header
 	file.header = std::make_unique<volume_header>();
 	if(Decoder::DecodeHeader(archive, file.header) < 0)
@@ -275,6 +388,10 @@ int Decoder::DecodeArchive(const std::string &file_name, const bool &dump, archi
 	// Initialize all elevation indices to null
 	file.scan_elevations.fill(nullptr);
 
+	// Damaged records skipped in recovery mode leave the volume partial
+	file.bad_records = archive.badRecords();
+	file.partial = !file.bad_records.empty();
+
 	// Parse all messages remaining
 	if(Decoder::DecodeMessages(archive, file) < 0)
 		return -1;
@@ -286,4 +403,3 @@ int Decoder::DecodeArchive(const std::string &file_name, const bool &dump, archi
 
 	return 0;
 }
-
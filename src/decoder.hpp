@@ -7,11 +7,20 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <fstream>
 #include <vector>
 #include <memory>
+#include <functional>
+#include <array>
 
 #include "lvltwodef.hpp"
+#include "layout.hpp"
+#include "byte_swap.hpp"
+#include "message_cursor.hpp"
+#include "mapped_file.hpp"
+#include "buffer_pool.hpp"
+#include "record_cache.hpp"
 
 /**
  * @namespace Decoder
@@ -20,24 +29,38 @@
 namespace Decoder
 {
 	/**
-	 * @brief Reverses the endianness of an arbitrary integral type
-	 * @tparam T	The integral (not checked) datatype to reverse
-	 * @param data	Reference to the data for which the endianness should be reversed
-	 * @return	Copy of data with endianness reveresed	
+	 * @struct ArchiveOptions
+	 * @brief Options controlling how an ArchiveFile decompresses an archive file
+	 * @member gzip
+	 * Member 'gzip' is whether to attempt to perform Gzip decompression
+	 * @member bzip
+	 * Member 'bzip' is whether to attempt to perform bzip2 decompression of LDM records
+	 * @member threads
+	 * Member 'threads' is the number of threads used to decompress LDM records (1 decompresses serially, 0 uses one per hardware core)
+	 * @member recover
+	 * Member 'recover' is whether to fall back to scanning every byte for bzip2 streams when the record control words are damaged, and to skip (and report) LDM records that fail to decompress rather than failing the whole archive
+	 * @member mmap
+	 * Member 'mmap' is whether to memory map non-Gzip files rather than reading them (uncompressed archives are then read in place, without copies)
+	 * @member pipeline_depth
+	 * Member 'pipeline_depth' is how many decompressed LDM records may wait for the parser when DecodeArchive pipelines decompression with parsing (0 disables pipelining)
+	 * @member pool
+	 * Member 'pool' is a buffer pool (shareable across archives and threads) that decompression buffers are taken from and returned to (nullptr disables pooling)
+	 * @member cache
+	 * Member 'cache' is an on-disk cache (shareable across archives, threads and processes) of decompressed LDM records to map instead of decompressing (nullptr disables caching)
+	 * @member elevations
+	 * Member 'elevations' is the elevation numbers DecodeArchive should decode (empty decodes all). When set, LDM records are decompressed lazily, in order, and decoding stops once every requested elevation is complete
 	*/
-	template <typename T>
-	T reverseEndian(const T& data){
-		size_t num_bytes = sizeof(T);
-
-		T reverse_endian = 0;
-		for(int i=0; i<num_bytes; i++){
-			reverse_endian |= ((data >> (8 * i)) & 0xFF) << (8 * (num_bytes - 1 - i));
-		}
-
-		if(num_bytes == 1) reverse_endian = data;
-
-		return reverse_endian;
-	}
+	struct ArchiveOptions{
+		bool gzip = true;
+		bool bzip = true;
+		unsigned int threads = 1;
+		bool recover = false;
+		bool mmap = false;
+		size_t pipeline_depth = 0;
+		std::shared_ptr<BufferPool> pool;
+		std::shared_ptr<RecordCache> cache;
+		std::vector<uint8_t> elevations;
+	};
 
 	/**
 	 * @class ArchiveFile
@@ -45,41 +68,301 @@ namespace Decoder
 	*/
 	class ArchiveFile{
 	private:
+		/**
+		 * @struct segment
+		 * @brief A contiguous run of archive bytes, either owned (decompressed records) or viewed in place (mapped pages or caller bytes)
+		 * @member storage
+		 * Member 'storage' is a vector owning the bytes (empty when the bytes are viewed in place)
+		 * @member bytes
+		 * Member 'bytes' is a pointer to the first byte of the segment
+		 * @member size
+		 * Member 'size' is the number of bytes in the segment
+		 * @member start
+		 * Member 'start' is the position of the first byte of the segment within the archive
+		 * @member cached
+		 * Member 'cached' is the mapped record cache entry the segment views (kept alive with the segment), nullptr otherwise
+		*/
+		typedef struct {
+			std::vector<uint8_t> storage;
+			const uint8_t *bytes;
+			uint64_t size;
+			uint64_t start;
+			std::shared_ptr<MappedFile> cached;
+		} segment;
+
 		bool initialized;
-		std::vector<uint8_t> data; 
+		std::vector<segment> segments;
+		size_t current;
+		std::unique_ptr<MappedFile> mapping;
+		uint64_t length;
 		uint64_t pointer;
+		uint64_t released;
 		uint16_t blocks;
+		std::vector<ldm_record> ldm_records;
+		size_t record_count;
+		std::vector<size_t> bad_records;
+		std::vector<uint8_t> stitched;
+		ArchiveOptions archive_options;
+
+		/**
+		 * @brief Takes an empty buffer from the pool (or a new one without a pool)
+		 * @param min_capacity Capacity to reserve
+		 * @return Empty buffer
+		*/
+		std::vector<uint8_t> acquireBuffer(size_t min_capacity);
+
+		/**
+		 * @brief Gives a buffer back to the pool (or frees it without a pool)
+		 * @param buffer Buffer to give back
+		*/
+		void recycleBuffer(std::vector<uint8_t> &&buffer);
+
+		/**
+		 * @brief Copies bytes into a (pooled) buffer
+		 * @param bytes Pointer to the first byte to copy
+		 * @param size Number of bytes to copy
+		 * @return Buffer holding the copy
+		*/
+		std::vector<uint8_t> copyBuffer(const uint8_t *bytes, uint64_t size);
+
+		/**
+		 * @brief Makes default options with Gzip and bzip2 decompression turned on or off
+		 * @param gzip Whether to attempt to perform Gzip decompression
+		 * @param bzip Whether to attempt to perform bzip2 decompression
+		 * @return Options
+		*/
+		static ArchiveOptions compressionOptions(bool gzip, bool bzip){
+			ArchiveOptions options;
+			options.gzip = gzip;
+			options.bzip = bzip;
+			return options;
+		}
+
+		/**
+		 * @brief Frames (post-Gzip) chunk bytes into LDM records and appends them
+		 * @param in Pointer to the (post-Gzip) chunk bytes
+		 * @param in_size Number of chunk bytes
+		 * @return 0 on success, -1 on any error
+		*/
+		int appendChunk(const uint8_t *in, uint64_t in_size);
+
+		/**
+		 * @brief Adds a segment owning the given bytes to the end of the archive
+		 * @param storage Bytes to take ownership of (empty vectors are ignored)
+		*/
+		void addSegment(std::vector<uint8_t> &&storage);
 
 		/**
-		 * @brief Decompresses the entire file (if Gzip compressed) into a given out vector
+		 * @brief Adds a segment viewing bytes in place (which must outlive this object) to the end of the archive
+		 * @param bytes Pointer to the first byte
+		 * @param size Number of bytes
+		*/
+		void addSegment(const uint8_t *bytes, uint64_t size);
+
+		/**
+		 * @brief Adds a segment viewing a mapped record cache entry (kept mapped until the segment is dropped) to the end of the archive
+		 * @param cached Mapped cache entry
+		*/
+		void addSegment(RecordCache::Entry &&cached);
+
+		/**
+		 * @brief Decompresses one compressed LDM record, or maps its payload from the record cache (storing it there after a miss)
+		 * @param in Pointer to the (post-Gzip) archive bytes the record was located in
+		 * @param record A reference to the located record
+		 * @param out A reference to a vector to store the decompressed bytes (left empty on a cache hit)
+		 * @param cached A reference to store the mapped cache entry in (its mapping left nullptr on a miss)
+		 * @return 0 on success, -1 if the record failed to decompress
+		*/
+		int decompressRecord(const uint8_t *in, const ldm_record &record, std::vector<uint8_t> &out, RecordCache::Entry &cached);
+
+		/**
+		 * @brief Finds the segment holding a given position
+		 * @param pos Position within the archive (must be < size())
+		 * @return Index of the segment holding pos
+		*/
+		size_t locate(uint64_t pos);
+
+		/**
+		 * @brief Decompresses located LDM records on a pool of threads and adds them, in order, as segments
+		 * @param in Pointer to the (post-Gzip) archive bytes
+		 * @param in_size Number of archive bytes
+		 * @param records A reference to the vector of located records
+		 * @param threads Number of threads to decompress with (0 for one per hardware core)
+		 * @return 0 on success (damaged records skipped in recovery mode), -1 on any error
+		*/
+		int decompressRecords(const uint8_t *in, uint64_t in_size, const std::vector<ldm_record> &records, unsigned int threads);
+
+		/**
+		 * @brief Frames and decompresses (post-Gzip) archive bytes, then points the cursor at the result
+		 * @param in Pointer to the (post-Gzip) archive bytes
+		 * @param in_size Number of archive bytes
+		 * @param post_gzip A reference to the vector owning the Gzip output (empty when in is not owned by this object)
+		 * @param options Options controlling decompression (see ArchiveOptions)
+		*/
+		void decompress(const uint8_t *in, uint64_t in_size, std::vector<uint8_t> &post_gzip, const ArchiveOptions &options);
+
+		/**
+		 * @brief Decompresses located LDM records one after another, appending each as its own segment
+		 * @param in Pointer to the (post-Gzip) archive bytes the records were located in
+		 * @param records A reference to the vector of located records
+		 * @return 0 on success (damaged records skipped in recovery mode), -1 on any error
+		*/
+		int appendRecords(const uint8_t *in, const std::vector<ldm_record> &records);
+
+	public:
+		/**
+		 * @brief Reads the ISIZE trailer of a Gzip stream as a presizing hint, clamped to what the compressed bytes could possibly inflate to
+		 * (the trailer of a truncated or corrupt stream is arbitrary bytes)
+		 * @param trailer Pointer to the last 4 bytes of the stream
+		 * @param compressed_size Size of the whole compressed stream
+		 * @return Expected uncompressed size, never more than GZIP_MAX_SIZE_HINT
+		*/
+		static uint64_t gzipSizeHint(const uint8_t *trailer, uint64_t compressed_size);
+
+		/**
+		 * @brief Inflates one Gzip stream, pulling compressed input chunk by chunk, into a given out vector
+		 * @param next_chunk Callable that points its argument at the next chunk of compressed input and returns its size (0 when exhausted)
+		 * @param isize Expected uncompressed size (from the Gzip ISIZE trailer) used to presize out, 0 if unknown
+		 * @param out A reference to a vector to store the inflated bytes
+		 * @return 0 on success, -1 on any error
+		*/
+		static int inflateGzip(const std::function<size_t(const uint8_t *&)> &next_chunk, uint64_t isize, std::vector<uint8_t> &out);
+
+		/**
+		 * @brief Decompresses the entire file (if Gzip compressed, peeling any nested Gzip layers) into a given out vector
 		 * @param file_name	A string representing the file name of the archive file
 		 * @param out	A reference to a vector to store the decompressed file (bytes)
+		 * @param gzip Whether to attempt to perform Gzip decompression
+		 * @param pool Buffer pool to take scratch buffers from (nullptr for none)
 		 * @return 0 on success, -1 on any error
 		*/
-		int decompressGzip(const std::string &file_name, std::vector<uint8_t> &out, const bool &gzip);
+		static int decompressGzip(const std::string &file_name, std::vector<uint8_t> &out, const bool &gzip, BufferPool *pool = nullptr);
+
+		/**
+		 * @brief Decompresses a Gzip stream held in memory (peeling any nested Gzip layers) into a given out vector
+		 * @param bytes Pointer to the Gzip compressed bytes
+		 * @param size Number of compressed bytes
+		 * @param out A reference to a vector to store the decompressed bytes
+		 * @param pool Buffer pool to take scratch buffers from (nullptr for none)
+		 * @return 0 on success, -1 on any error
+		*/
+		static int decompressGzip(const uint8_t *bytes, size_t size, std::vector<uint8_t> &out, BufferPool *pool = nullptr);
 
 		/**
 		 * @brief Decompresses a block of Bzip2 compressed data to a given out vector
 		 * @param compressed_block	Pointer to a buffer of compressed data
 		 * @param size	Size of compressed block in bytes
-		 * @param out	A reference to a vector to store the decompressed block (bytes)
+		 * @param out	A reference to a vector to store the decompressed block (bytes), whose existing capacity is used first
+		 * @return 0 on success, -1 on corrupt, truncated or implausibly large data (detected without waiting on more input)
+		*/
+		static int decompressBzip2(const uint8_t *compressed_block, size_t size, std::vector<uint8_t> &out);
+
+		/**
+		 * @brief Decompresses a whole file of (one or more concatenated) bzip2 streams by locating the bit-aligned block
+		 * magic numbers and decompressing every block on its own, concurrently, before stitching the output back together
+		 * Falls back to decompressing the streams one after another when the blocks cannot be split apart
+		 * @param in Pointer to the bzip2 compressed bytes
+		 * @param in_size Number of compressed bytes
+		 * @param out A reference to a vector to store the decompressed bytes
+		 * @param threads Number of threads to decompress with (0 for one per hardware core)
+		 * @param pool Buffer pool to take per-block buffers from (nullptr for none)
 		 * @return 0 on success, -1 on any error
 		*/
-		int decompressBzip2(const uint8_t *compressed_block, size_t size, std::vector<uint8_t> &out);
+		static int decompressBzip2Stream(const uint8_t *in, uint64_t in_size, std::vector<uint8_t> &out, unsigned int threads, BufferPool *pool = nullptr);
+
+		/**
+		 * @brief Locates the LDM records in a (post-Gzip) archive by following the control word at the start of each record
+		 * @param in Pointer to the (post-Gzip) archive bytes
+		 * @param in_size Number of archive bytes
+		 * @param records A reference to a vector to store the located records (and the bytes between them) in order
+		 * @return 0 on success, -1 if a control word does not frame a bzip2 stream (damaged archive)
+		*/
+		static int walkRecords(const uint8_t *in, uint64_t in_size, std::vector<ldm_record> &records);
+
+		/**
+		 * @brief Locates the LDM records in a (post-Gzip) archive by scanning for bzip2 stream headers (recovery mode)
+		 * @param in Pointer to the (post-Gzip) archive bytes
+		 * @param in_size Number of archive bytes
+		 * @param records A reference to a vector to store the located records (and the bytes between them) in order
+		*/
+		static void scanRecords(const uint8_t *in, uint64_t in_size, std::vector<ldm_record> &records);
 
-	public:
 		/**
 		 * @brief Constructor accepting file name and option of turning off either or both Gzip and Bzip decompression
 		 * @param file_name	Name of archive file
 		 * @param gzip Whether to attempt to perform Gzip decompression
 		 * @param bzip Whether to attempt to perfrom bzip2 decompression
 		*/
-		ArchiveFile(const std::string &file_name, const bool &gzip, const bool &bzip);
+		ArchiveFile(const std::string &file_name, const bool &gzip, const bool &bzip)
+			: ArchiveFile(file_name, compressionOptions(gzip, bzip)) {}
+		/**
+		 * @brief Constructor accepting file name and a set of decompression options
+		 * @param file_name Name of archive file
+		 * @param options Options controlling decompression (see ArchiveOptions)
+		*/
+		ArchiveFile(const std::string &file_name, const ArchiveOptions &options);
 	  	/**
 		 * @brief Constructor only accpeting file name, looking for both Gzip and Bzip2 compression
 		 * @param file_name String representing name of archive file
 		*/
-	 	ArchiveFile(const std::string &file_name) : ArchiveFile(file_name, true, true) {}
+	 	ArchiveFile(const std::string &file_name) : ArchiveFile(file_name, ArchiveOptions{}) {}
+
+		/**
+		 * @brief Constructor accepting a caller-owned archive held in memory, detecting Gzip, bzip2 LDM records, or raw bytes
+		 * Raw (already decompressed) bytes are read in place, so they must outlive this object
+		 * @param bytes Pointer to the archive bytes
+		 * @param size Number of archive bytes
+		 * @param options Options controlling decompression (see ArchiveOptions, mmap is ignored)
+		*/
+		ArchiveFile(const uint8_t *bytes, size_t size, const ArchiveOptions &options);
+		/**
+		 * @brief Constructor accepting a caller-owned archive held in memory, looking for both Gzip and Bzip2 compression
+		 * @param bytes Pointer to the archive bytes
+		 * @param size Number of archive bytes
+		*/
+		ArchiveFile(const uint8_t *bytes, size_t size) : ArchiveFile(bytes, size, ArchiveOptions{}) {}
+
+		/**
+		 * @brief Constructor for an initially empty archive that is filled by appending chunks (see append)
+		 * @param options Options controlling decompression of appended chunks (see ArchiveOptions, mmap is ignored)
+		*/
+		explicit ArchiveFile(const ArchiveOptions &options);
+
+		/**
+		 * @brief Destructor returning decompressed segments to the buffer pool (if any)
+		*/
+		~ArchiveFile();
+
+		ArchiveFile(ArchiveFile&&) = default;
+		ArchiveFile& operator=(ArchiveFile&&) = default;
+
+		/**
+		 * @brief Decompresses a chunk of archive bytes (e.g. a real-time start, intermediate, or end chunk) and appends it
+		 * The internal pointer is left where it is, so already decoded data does not need to be read again
+		 * @param bytes Pointer to the chunk bytes
+		 * @param size Number of chunk bytes
+		 * @return 0 on success, -1 on any error
+		*/
+		int append(const uint8_t *bytes, size_t size);
+
+		/**
+		 * @brief Appends already decompressed bytes, taking ownership of them without copying
+		 * @param bytes Decompressed bytes to append
+		 * @return 0 on success, -1 on any error
+		*/
+		int append(std::vector<uint8_t> &&bytes);
+
+		/**
+		 * @brief Appends a mapped record cache entry, viewing its payload in place (kept mapped until released)
+		 * @param cached Mapped cache entry
+		 * @return 0 on success, -1 on any error
+		*/
+		int append(RecordCache::Entry &&cached);
+
+		/**
+		 * @brief Releases the bytes before the internal pointer, which then becomes position 0 (see releasedBytes)
+		*/
+		void release();
 
 		/**
 		 * @brief Reads size number of bytes into buffer, starting from internal pointer
@@ -110,6 +393,19 @@ namespace Decoder
 			return bytes_read;	
 		}
 
+		/**
+		 * @brief Reads a whole fixed layout (see layout.hpp) with a single bounds check and copy, its fields decoded on access
+		 * @tparam T Layout type (byte aligned, trivially copyable)
+		 * @param layout Reference to the layout to read into
+		 * @return Number of bytes read into layout (0 if fewer than sizeof(T) bytes remain, the internal pointer then stays put)
+		 */
+		template <typename T>
+		size_t readLayout(T &layout){
+			static_assert(std::is_trivially_copyable<T>::value && alignof(T) == 1, "Layouts are byte aligned and trivially copyable");
+			if(!initialized || pointer > length || length - pointer < sizeof(T)) return 0;
+			return read(reinterpret_cast<uint8_t*>(&layout), sizeof(T));
+		}
+
 		/**
 		 * @brief Reads floating point data into a float reference
 		 * @param buffer Reference to a float
@@ -118,10 +414,25 @@ namespace Decoder
 		size_t readFloat(float &buffer);
 
 		/**
-		 * @brief Returns the entire buffer of data
+		 * @brief Views len bytes starting from pos without moving the internal pointer. Bytes within one segment are viewed in place,
+		 * bytes spanning segments are stitched into a scratch buffer that the next stitched view reuses
+		 * @param pos Position of the first byte
+		 * @param len Number of bytes to view
+		 * @return View of the bytes (shorter than len when the archive ends first), valid until the archive changes or the next stitched view
+		*/
+		std::string_view view(uint64_t pos, uint64_t len);
+
+		/**
+		 * @brief Returns a copy of the entire buffer of data
 		 * @return Data buffer
 		*/
-		std::vector<uint8_t> getAll(){ return data; }
+		std::vector<uint8_t> getAll();
+
+		/**
+		 * @brief Views the entire buffer of data without copying, as its contiguous segments in order
+		 * @return Views of each segment, valid until the archive changes
+		*/
+		std::vector<std::string_view> segmentViews() const;
 
 		/**
 		 * @brief Skips over a given number of bytes by moving the internal pointer by that amount
@@ -150,6 +461,19 @@ namespace Decoder
 		*/
 		void dump_to_file(const std::string &file_name);
 
+		/**
+		 * @brief Writes (binary) contents to a stream segment by segment, without copying them first
+		 * @param out Stream to write contents to
+		 * @return 0 on success, -1 on any error
+		*/
+		int dump(std::ostream &out);
+
+		/**
+		 * @brief Tells whether the cursor runs over memory mapped file pages (no copy of the file was made)
+		 * @returns Boolean indicator of whether the data is memory mapped
+		*/
+		bool isMapped();
+
 		/**
 		 * @brief Tells whether object is initialized
 		 * @returns Internal boolean initialization flag
@@ -160,13 +484,13 @@ namespace Decoder
 		 * @brief Tell whether object is at EOF
 		 * @returns Boolean comparison if pointer is at end
 		 */
-		bool at_end(){ return pointer >= data.size(); }
+		bool at_end(){ return pointer >= length; }
 
 		/**
 		 * @brief Tells object size
-		 * @returns Internal data vector size
+		 * @returns Internal data size
 		 */
-		size_t size(){ return data.size(); }
+		size_t size(){ return length; }
 
 		/**
 		 * @brief Tells number of BZIP2 blocks decompressed
@@ -174,12 +498,30 @@ namespace Decoder
 		 */
 		uint16_t num_blocks(){ return blocks; }
 
+		/**
+		 * @brief Tells where each LDM record was located in the (post-Gzip) archive
+		 * @returns Internal vector of located records, in order
+		 */
+		const std::vector<ldm_record> &records(){ return ldm_records; }
+
+		/**
+		 * @brief Tells which LDM records were skipped because they failed to decompress (recovery mode only)
+		 * @returns Internal vector of the indices of skipped records, in order
+		 */
+		const std::vector<size_t> &badRecords(){ return bad_records; }
+
 		/**
 		 * @brief Tells the position of the internal byte pointer
 		 * @returns Internal pointer position
 		 */
 		uint64_t position(){ return pointer; }
 
+		/**
+		 * @brief Tells how many bytes release has dropped, i.e. how far into the whole volume position 0 now is
+		 * @returns Number of released bytes
+		 */
+		uint64_t releasedBytes(){ return released; }
+
 		/**
 		 * @brief Prints out a given number of bytes starting from the internal position
 		 * @param amt The number of byte to print
@@ -187,6 +529,77 @@ namespace Decoder
 		void peek(const uint64_t amt);
 	};
 
+	/**
+	 * @class ChunkDecoder
+	 * @brief Incrementally decodes a volume delivered as real-time Level II chunks (start, intermediate, and end chunks),
+	 * publishing each elevation as soon as its end-of-elevation radial arrives
+	*/
+	class ChunkDecoder{
+	private:
+		ArchiveFile archive;
+		archive_file &file;
+		std::function<void(const std::shared_ptr<elevation_head>&)> on_elevation;
+		std::array<bool, 33> published;
+		bool header_decoded;
+		bool metadata_decoded;
+		bool volume_complete;
+
+		/**
+		 * @brief Publishes every elevation whose latest radial ends the elevation (or volume) and was not yet published
+		*/
+		void publishElevations();
+
+		/**
+		 * @brief Decodes whatever the appended data now completes (header, metadata, then messages) and publishes finished elevations
+		 * @return Status of decode attempt. See documentation for reference (TBD)
+		*/
+		int decodeAvailable();
+
+	public:
+		/**
+		 * @brief Constructor accepting where to decode the volume to and who to notify of completed elevations
+		 * @param file A reference to an archive_file struct to write decoded information to (must outlive this object)
+		 * @param on_elevation Callable invoked with each elevation once it is complete
+		 * @param options Options controlling decompression of chunks (see ArchiveOptions, mmap is ignored)
+		*/
+		ChunkDecoder(archive_file &file, std::function<void(const std::shared_ptr<elevation_head>&)> on_elevation,
+			const ArchiveOptions &options = ArchiveOptions{});
+
+		/**
+		 * @brief Decompresses a newly arrived chunk and decodes every message it completes
+		 * @param chunk Pointer to the chunk bytes
+		 * @param size Number of chunk bytes
+		 * @return Status of decode attempt. See documentation for reference (TBD)
+		*/
+		int push(const uint8_t *chunk, size_t size);
+
+		/**
+		 * @brief Takes ownership of already decompressed archive bytes and decodes every message they complete
+		 * @param decompressed Decompressed archive bytes (e.g. one LDM record)
+		 * @return Status of decode attempt. See documentation for reference (TBD)
+		*/
+		int push(std::vector<uint8_t> &&decompressed);
+
+		/**
+		 * @brief Adopts a mapped record cache entry as decompressed archive bytes, without copying, and decodes every message it completes
+		 * @param cached Mapped cache entry (e.g. of one LDM record)
+		 * @return Status of decode attempt. See documentation for reference (TBD)
+		*/
+		int push(RecordCache::Entry &&cached);
+
+		/**
+		 * @brief Tells whether the end-of-volume radial has been decoded
+		 * @returns Boolean indicator of whether the volume is complete
+		*/
+		bool complete(){ return volume_complete; }
+
+		/**
+		 * @brief Tells whether everything pushed so far formed a complete decode
+		 * @return 0 if all pushed data was decoded, -1 if the header or metadata never arrived, -2 if undecoded bytes remain
+		*/
+		int finish();
+	};
+
 	/**
 	 * @brief Decodes a NEXRAD Level 2 archive file, decompressing if necessary
 	 * @param file_name	Name of the NEXRAD Level 2 archieve file
@@ -196,6 +609,123 @@ namespace Decoder
 	*/
 	int DecodeArchive(const std::string& file_name, const bool &dump, archive_file &file);
 
+	/**
+	 * @brief Decodes a NEXRAD Level 2 archive file, decompressing according to the given options
+	 * @param file_name	Name of the NEXRAD Level 2 archieve file
+	 * @param dump Whether to dump the decompressed archive file to "./DUMP"
+	 * @param file	A reference of an archive_file struct to hold data from archive file
+	 * @param options Options controlling decompression (see ArchiveOptions)
+	 * @return	Status of decode attempt. See documentation for reference (TBD)
+	*/
+	int DecodeArchive(const std::string& file_name, const bool &dump, archive_file &file, const ArchiveOptions &options);
+
+	/**
+	 * @brief Decodes a NEXRAD Level 2 archive held in memory, decompressing if necessary (never touches the filesystem)
+	 * @param bytes Pointer to the caller-owned archive bytes
+	 * @param size Number of archive bytes
+	 * @param file	A reference of an archive_file struct to hold data from archive file
+	 * @param options Options controlling decompression (see ArchiveOptions)
+	 * @return	Status of decode attempt. See documentation for reference (TBD)
+	*/
+	int DecodeArchive(const uint8_t *bytes, size_t size, archive_file &file, const ArchiveOptions &options);
+
+	/**
+	 * @brief Streams a tar bundle (optionally Gzip compressed) of archive files, decoding each member from memory on a pool
+	 * of threads without extracting it to disk. Decoded volumes are handed back in bundle order, on the calling thread
+	 * @param bundle_name Name of the tar bundle
+	 * @param options Options controlling decompression of each member (see ArchiveOptions)
+	 * @param threads Number of members decoded concurrently (0 for one per hardware core)
+	 * @param on_volume Called with each regular member's name, DecodeArchive status and decoded volume, in bundle order
+	 * @return 0 once every member was handed back, -1 if the bundle could not be read or is malformed (members before the damage are still handed back)
+	*/
+	int DecodeBundle(const std::string &bundle_name, const ArchiveOptions &options, unsigned int threads,
+		const std::function<void(const std::string&, int, archive_file&)> &on_volume);
+
+	/**
+	 * @brief Decodes a batch of archive files, keeping many file reads in flight (through io_uring where available) and decoding
+	 * loaded files from memory on a pool of threads, so disk latency overlaps decompression and parsing
+	 * @param file_names Names of the archive files
+	 * @param options Options controlling decompression of each archive (see ArchiveOptions)
+	 * @param threads Number of archives decoded concurrently (0 for one per hardware core)
+	 * @param on_volume Called with each file's name, DecodeArchive status and decoded volume, in the order file reads complete
+	 * @return 0 once every file was handed back, -1 if any file could not be read (it is still handed back, with a -1 status)
+	*/
+	int DecodeFiles(const std::vector<std::string> &file_names, const ArchiveOptions &options, unsigned int threads,
+		const std::function<void(const std::string&, int, archive_file&)> &on_volume);
+
+	/**
+	 * @brief Finds the volumes of a stream of concatenated (post-Gzip) archives, each starting at its "AR2V00" volume header.
+	 * Compressed volumes end after their last LDM record, decompressed ones at the next volume header
+	 * @param bytes Pointer to the stream bytes
+	 * @param size Number of stream bytes
+	 * @param spans A reference to a vector to store the location of each volume, in stream order
+	 * @return 0 on success, -1 if the stream does not start with a volume header
+	*/
+	int SplitVolumes(const uint8_t *bytes, size_t size, std::vector<volume_span> &spans);
+
+	/**
+	 * @brief Decodes a stream of concatenated archives held in memory (optionally Gzip compressed as a whole), decoding the volumes concurrently
+	 * @param bytes Pointer to the caller-owned stream bytes
+	 * @param size Number of stream bytes
+	 * @param files A reference to a vector to store each decoded volume, in stream order
+	 * @param statuses A reference to a vector to store each volume's DecodeArchive status, in stream order
+	 * @param options Options controlling decompression of each volume (see ArchiveOptions)
+	 * @param threads Number of volumes decoded concurrently (0 for one per hardware core)
+	 * @return 0 if every volume decoded, -1 if the stream could not be read or holds no volume, -2 if any volume failed (see statuses)
+	*/
+	int DecodeVolumes(const uint8_t *bytes, size_t size, std::vector<archive_file> &files, std::vector<int> &statuses,
+		const ArchiveOptions &options, unsigned int threads = 0);
+
+	/**
+	 * @brief Decodes a file of concatenated archives (optionally Gzip compressed as a whole), decoding the volumes concurrently
+	 * @param file_name Name of the file
+	 * @param files A reference to a vector to store each decoded volume, in stream order
+	 * @param statuses A reference to a vector to store each volume's DecodeArchive status, in stream order
+	 * @param options Options controlling decompression of each volume (see ArchiveOptions)
+	 * @param threads Number of volumes decoded concurrently (0 for one per hardware core)
+	 * @return 0 if every volume decoded, -1 if the file could not be read or holds no volume, -2 if any volume failed (see statuses)
+	*/
+	int DecodeVolumes(const std::string &file_name, std::vector<archive_file> &files, std::vector<int> &statuses,
+		const ArchiveOptions &options, unsigned int threads = 0);
+
+	/**
+	 * @brief Decodes (post-Gzip) archive bytes with a decompression stage feeding LDM records through a bounded queue
+	 * to the parser, so parsing overlaps decompression and parsed records are released
+	 * @param in Pointer to the (post-Gzip) archive bytes
+	 * @param in_size Number of archive bytes
+	 * @param file	A reference of an archive_file struct to hold data from archive file
+	 * @param options Options controlling decompression (see ArchiveOptions, pipeline_depth of 0 queues a single record).
+	 * With requested elevations, decompression stops once they are complete and only they are kept in file (those missing from the volume stay nullptr)
+	 * @return	Status of decode attempt. See documentation for reference (TBD)
+	*/
+	int DecodePipelined(const uint8_t *in, uint64_t in_size, archive_file &file, const ArchiveOptions &options);
+
+	/**
+	 * @brief Decodes the volume held by an already constructed ArchiveFile
+	 * @param archive A reference to an ArchiveFile object to read from
+	 * @param file	A reference of an archive_file struct to hold data from archive file
+	 * @return	Status of decode attempt. See documentation for reference (TBD)
+	*/
+	int DecodeArchive(ArchiveFile &archive, archive_file &file);
+
+	/**
+	 * @brief Reads only the volume header and the first LDM record (the metadata record holding Message 5) of an archive file,
+	 * stopping there without decompressing or decoding any radials
+	 * @param file_name Name of the archive file (plain or Gzip compressed)
+	 * @param summary A reference to an archive_summary struct to write the identifying information to
+	 * @return 0 on success, -1 on any error, -2 if the header was read but no Message 5 was found (vcp left 0)
+	*/
+	int ProbeArchive(const std::string &file_name, archive_summary &summary);
+
+	/**
+	 * @brief Reads only the volume header and the first LDM record of an archive held in memory (see ProbeArchive above)
+	 * @param bytes Pointer to the caller-owned archive bytes (plain or Gzip compressed)
+	 * @param size Number of archive bytes
+	 * @param summary A reference to an archive_summary struct to write the identifying information to
+	 * @return 0 on success, -1 on any error, -2 if the header was read but no Message 5 was found (vcp left 0)
+	*/
+	int ProbeArchive(const uint8_t *bytes, size_t size, archive_summary &summary);
+
 	/**
 	 * @brief Decodes a NEXRAD Level 2 archive file header into the given volume_header struct
 	 * @param archive A reference to an ArchiveFile object to read from
@@ -214,16 +744,72 @@ namespace Decoder
 
 	/**
 	 * @brief Decodes non-metadata messages in archive file, recording data from select messages
+	 * Stops (with the internal pointer at its start) at a message extending past the end of the data, so decoding may resume once more data is appended
 	 * @param archive A reference to an ArchiveFile object to read from
 	 * @param file A reference to an archive_file struct to write decoded information to
 	 * @return Status of decode attempt. See documentation for reference (TBD)
 	 */
 	int DecodeMessages(ArchiveFile &archive, archive_file &file);
 
+	/**
+	 * @brief Reads the prefix and header of the message at the internal pointer and works out where the message ends
+	 * @param archive A reference to an ArchiveFile object to read from (left just past the message header, or at the frame start unless 0 is returned)
+	 * @param header A reference to a message_header_layout to read the header into
+	 * @param message_end A reference to write the position just past the message to
+	 * @return 0 on success, 1 if the message extends past the end of the data, -1 if the header is malformed
+	 */
+	int ReadMessageHeader(ArchiveFile &archive, message_header_layout &header, uint64_t &message_end);
+
+	/**
+	 * @brief Walks every message of a decompressed archive once (metadata messages included) without decoding them, recording where each is
+	 * @param archive A reference to an ArchiveFile object to read from (its internal pointer is left where it was)
+	 * @param index A reference to a vector to store an entry for every message, in archive order
+	 * @return 0 on success, -1 if the archive has no volume header or a message header is malformed
+	 */
+	int BuildMessageIndex(ArchiveFile &archive, std::vector<message_entry> &index);
+
+	/**
+	 * @brief Writes a message index to a file (conventionally the archive name followed by ".idx")
+	 * @param file_name Name of the index file
+	 * @param archive A reference to the decompressed archive the index was built from, whose size, volume header and metadata record hash are recorded
+	 * @param index Message index to write
+	 * @return 0 on success, -1 on any error
+	 */
+	int SaveMessageIndex(const std::string &file_name, ArchiveFile &archive, const std::vector<message_entry> &index);
+
+	/**
+	 * @brief Reads a message index written by SaveMessageIndex
+	 * @param file_name Name of the index file
+	 * @param archive A reference to the decompressed archive the index is used with (checked against the recorded size, volume header and metadata record hash)
+	 * @param index A reference to a vector to store the message index
+	 * @return 0 on success, -1 if the file could not be read, is not a message index, or belongs to a different archive
+	 */
+	int LoadMessageIndex(const std::string &file_name, ArchiveFile &archive, std::vector<message_entry> &index);
+
+	/**
+	 * @brief Decodes one indexed message with a direct seek (only Message 31 is decoded, other messages are skipped)
+	 * @param archive A reference to the ArchiveFile object the index was built from
+	 * @param entry Index entry of the message
+	 * @param file A reference to an archive_file struct to add the decoded radial to
+	 * @return 0 on success, -1 on any error
+	 */
+	int DecodeIndexedMessage(ArchiveFile &archive, const message_entry &entry, archive_file &file);
+
+	/**
+	 * @brief Decodes every radial of one elevation through the message index, leaving the rest of the archive untouched
+	 * @param archive A reference to the ArchiveFile object the index was built from
+	 * @param index Message index of the archive
+	 * @param elevation_num Elevation number to decode
+	 * @param file A reference to an archive_file struct to add the elevation to
+	 * @return 0 on success, -1 on any error (including no radials for the elevation)
+	 */
+	int DecodeIndexedElevation(ArchiveFile &archive, const std::vector<message_entry> &index, uint8_t elevation_num, archive_file &file);
+
 	namespace Message31{	
 		/**
 		 * @brief Parses Message 31, starting from the message header, then moves
 		 * to constant block followed by radial blocks (only REF right now)
+		 * The message extent is taken from the preceding message header, and the internal pointer is left at the message end
 		 * @param archive A reference to an ArchiveFile object to read from
 		 * @param file A reference to an archive_file struct to write decoded information to
 		 * @return Status of decode attempt. See documentation for reference (TBD)
@@ -231,11 +817,38 @@ namespace Decoder
 		int ParseMessage31(ArchiveFile &archive, archive_file &file);
 
 		/**
-		 * @brief Parses the radial for all products (only REF right now)
-		 * @param archive A reference to an ArchiveFile object ot read from
+		 * @brief Parses Message 31 from a cursor over exactly the message (from the Message 31 header to the message end),
+		 * checking each block fits once and reading it unchecked
+		 * @param cursor A reference to a MessageCursor over the message
+		 * @param file A reference to an archive_file struct to write decoded information to
+		 * @return Status of decode attempt. See documentation for reference (TBD)
+		 */
+		int ParseMessage31(MessageCursor &cursor, archive_file &file);
+
+		/**
+		 * @brief Reads Message 31 into a radial_view without allocating, from a cursor over exactly the message
+		 * @param cursor A reference to a MessageCursor over the message
+		 * @param view A reference to a radial_view to fill (its gate pointers point into the cursor's bytes)
+		 * @param diagnostics A reference to the Diagnostics of the decode, to report problems to
+		 * @return 0 on success (ref.gates is nullptr when the REF block is unreadable), -1 if the message is shorter than its header
+		 */
+		int ReadRadial(MessageCursor &cursor, radial_view &view, Diagnostics &diagnostics);
+
+		/**
+		 * @brief Reads the REF data block header and views its gates in place
+		 * @param cursor A reference to a MessageCursor over the Message 31 (block pointers are relative to its start)
+		 * @param block_ptr Pointer to the REF data block
+		 * @param ref A reference to a moment_view to fill
+		 * @param diagnostics A reference to the Diagnostics of the decode, to report problems to
+		 * @return 0 on success, -1 if the block is missing, truncated or made of gates that are neither 8 nor 16-bit
+		 */
+		int ReadReflectivity(MessageCursor &cursor, uint32_t block_ptr, moment_view &ref, Diagnostics &diagnostics);
+
+		/**
+		 * @brief Parses the radial for all products (only REF right now), converting the viewed gates to true values
+		 * @param ref A reference to the moment_view of the REF gates (gates must not be nullptr)
 		 * @param cur_radial A reference to a radial_data object giving information about the current radial (and where to store pared information)
-		 * @param begin_header_pos The byte position of the beginning of the Message 31 (non-generic) header
 		 */
-		int ParseRadial(ArchiveFile &archive, std::shared_ptr<radial_data> &cur_radial, uint64_t begin_header_pos);
+		int ParseRadial(const moment_view &ref, std::shared_ptr<radial_data> &cur_radial);
 	}
 }
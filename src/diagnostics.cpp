@@ -0,0 +1,60 @@
+#include <iostream>
+#include <vector>
+#include <numeric>
+
+#include "diagnostics.hpp"
+
+
+Decoder::Diagnostics::Diagnostics(size_t capacity)
+	: capacity(capacity), next(0), messages(0), offset(0), echo(false){
+	counts.fill(0);
+}
+
+void Decoder::Diagnostics::push(const diagnostic_event &event){
+	if(capacity == 0) return;
+	if(ring.size() < capacity) ring.push_back(event);
+	else ring[next] = event;
+	next = (next + 1) % capacity;
+}
+
+void Decoder::Diagnostics::report(DiagnosticCode code){
+	counts[static_cast<size_t>(code)]++;
+
+	// The ring is only allocated once something goes wrong, clean decodes never touch it
+	push({code, messages, offset});
+
+	if(echo) std::cerr << describe(code) << " (Message #" << messages << " at " << offset << ")" << std::endl;
+}
+
+uint64_t Decoder::Diagnostics::total() const{
+	return std::accumulate(counts.begin(), counts.end(), uint64_t(0));
+}
+
+std::vector<Decoder::diagnostic_event> Decoder::Diagnostics::events() const{
+	// Until the ring fills, next is one past the newest event and the oldest is at 0
+	if(ring.size() < capacity) return ring;
+	std::vector<diagnostic_event> ordered(ring.begin()+next, ring.end());
+	ordered.insert(ordered.end(), ring.begin(), ring.begin()+next);
+	return ordered;
+}
+
+void Decoder::Diagnostics::merge(const Diagnostics &other){
+	for(size_t i=0; i<counts.size(); i++) counts[i] += other.counts[i];
+	messages += other.messages;
+	for(const diagnostic_event &event : other.events()) push(event);
+}
+
+const char* Decoder::Diagnostics::describe(DiagnosticCode code){
+	switch(code){
+		case DiagnosticCode::HEADER_ONLY: return "Unexpected EOF. Archive is header only.";
+		case DiagnosticCode::MALFORMED_MESSAGE_HEADER: return "Error parsing message header.";
+		case DiagnosticCode::IMPROPER_SEGMENT_FIELDS: return "Message with less than 65534 halfwords has improper message segment fields.";
+		case DiagnosticCode::MESSAGE_31_TOO_SHORT: return "Message 31 shorter than its header.";
+		case DiagnosticCode::ELEVATION_OUT_OF_RANGE: return "Message 31 elevation number out of range.";
+		case DiagnosticCode::REF_BLOCK_TRUNCATED: return "REF data block extends past the end of Message 31.";
+		case DiagnosticCode::MISSING_DREF: return "Unable to find \"DREF\" indicator in REF data block.";
+		case DiagnosticCode::IMPROPER_WORD_SIZE: return "Improper moment word size for REF (expected 8 or 16).";
+		case DiagnosticCode::GATES_TRUNCATED: return "REF gates extend past the end of Message 31.";
+		default: return "Unknown diagnostic.";
+	}
+}
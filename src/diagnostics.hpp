@@ -0,0 +1,140 @@
+/**
+ * @file diagnostics.hpp
+ * @brief Header file for collecting structured decode warnings and errors, rather than printing them from the decode loops
+ * @author Owen Capell
+*/
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @namespace Decoder
+ * @brief Encapsulate decoding functions
+*/
+namespace Decoder
+{
+	/**
+	 * @enum DiagnosticCode
+	 * @brief Kinds of problem found while decoding messages
+	*/
+	enum class DiagnosticCode : uint8_t {
+		HEADER_ONLY,                // No messages follow the metadata record
+		MALFORMED_MESSAGE_HEADER,   // Message header gives an impossible size
+		IMPROPER_SEGMENT_FIELDS,    // Message under 65534 halfwords with segment fields other than 1 of 1
+		MESSAGE_31_TOO_SHORT,       // Message 31 shorter than its own header
+		ELEVATION_OUT_OF_RANGE,     // Message 31 elevation number past the last supported elevation
+		REF_BLOCK_TRUNCATED,        // REF data block header extends past the message end
+		MISSING_DREF,               // REF data block pointer does not point at a "DREF" block
+		IMPROPER_WORD_SIZE,         // REF gates are neither 8 nor 16 bits
+		GATES_TRUNCATED,            // REF gates extend past the message end
+		COUNT
+	};
+
+	/**
+	 * @struct diagnostic_event
+	 * @brief One recorded problem
+	 * @member code
+	 * Member 'code' is the kind of problem
+	 * @member message_num
+	 * Member 'message_num' is the (1-based) number of the message it was found in, counted across every DecodeMessages call of the decode
+	 * @member offset
+	 * Member 'offset' is the position of the message frame within the whole decompressed volume (including any bytes already released by chunked decodes)
+	*/
+	typedef struct {
+		DiagnosticCode code;
+		uint64_t message_num;
+		uint64_t offset;
+	} diagnostic_event;
+
+	/**
+	 * @class Diagnostics
+	 * @brief Per-decode counters of each diagnostic code, plus a bounded ring of the latest events. Reporting does no I/O unless echo is
+	 * turned on, so decoding threads never contend on a shared stream
+	*/
+	class Diagnostics{
+	private:
+		std::array<uint64_t, static_cast<size_t>(DiagnosticCode::COUNT)> counts;
+		std::vector<diagnostic_event> ring;
+		size_t capacity;
+		size_t next;
+		uint64_t messages;
+		uint64_t offset;
+		bool echo;
+
+		/**
+		 * @brief Keeps an event, overwriting the oldest once the ring is full
+		 * @param event Event to keep
+		*/
+		void push(const diagnostic_event &event);
+
+	public:
+		/**
+		 * @brief Constructor accepting how many events to keep
+		 * @param capacity Number of latest events kept (older ones are only counted)
+		*/
+		explicit Diagnostics(size_t capacity = 64);
+
+		/**
+		 * @brief Marks the start of the next message, which later reports refer to
+		 * @param frame_offset Position of the message frame
+		*/
+		void beginMessage(uint64_t frame_offset){
+			messages++;
+			offset = frame_offset;
+		}
+
+		/**
+		 * @brief Records a problem with the current message
+		 * @param code Kind of problem
+		*/
+		void report(DiagnosticCode code);
+
+		/**
+		 * @brief Turns printing each event to std::cerr as it is reported on or off (off by default)
+		 * @param on Whether to print events
+		*/
+		void setEcho(bool on){ echo = on; }
+
+		/**
+		 * @brief Tells how often a problem was reported
+		 * @param code Kind of problem
+		 * @return Number of reports
+		*/
+		uint64_t count(DiagnosticCode code) const { return counts[static_cast<size_t>(code)]; }
+
+		/**
+		 * @brief Tells how many problems were reported in total
+		 * @return Number of reports
+		*/
+		uint64_t total() const;
+
+		/**
+		 * @brief Tells how many messages were walked
+		 * @return Number of messages
+		*/
+		uint64_t messageCount() const { return messages; }
+
+		/**
+		 * @brief Returns the kept events
+		 * @return Latest events, oldest first
+		*/
+		std::vector<diagnostic_event> events() const;
+
+		/**
+		 * @brief Adds another decode's counters and events to this one (e.g. to aggregate the decodes of many threads)
+		 * @param other Diagnostics to add
+		*/
+		void merge(const Diagnostics &other);
+
+		/**
+		 * @brief Describes a diagnostic code
+		 * @param code Kind of problem
+		 * @return Human readable description
+		*/
+		static const char* describe(DiagnosticCode code);
+	};
+}
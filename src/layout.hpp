@@ -0,0 +1,121 @@
+/**
+ * @file layout.hpp
+ * @brief Header file for compile-time layouts of the big endian message headers, read with one bounds check and decoded in place
+ * @author Owen Capell
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+
+#include "byte_swap.hpp"
+
+/**
+ * @namespace Decoder
+ * @brief Encapsulate decoding functions
+*/
+namespace Decoder
+{
+	/**
+	 * @struct BigEndian
+	 * @brief A big endian field stored as raw bytes (so layouts built from it have no padding and byte alignment), decoded on access
+	 * @tparam T Integral or float type of the field
+	*/
+	template <typename T>
+	struct BigEndian{
+		static_assert(std::is_integral<T>::value || std::is_same<T, float>::value, "BigEndian fields are integral or float");
+		uint8_t raw[sizeof(T)];
+
+		/**
+		 * @brief Decodes the field
+		 * @return Field value in host order
+		*/
+		T get() const{
+			typedef std::make_unsigned_t<std::conditional_t<std::is_same<T, float>::value, uint32_t, T>> Bits;
+			Bits bits;
+			std::memcpy(&bits, raw, sizeof(T));
+#if !(defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+			bits = reverseEndian(bits);
+#endif
+			T value;
+			std::memcpy(&value, &bits, sizeof(T));
+			return value;
+		}
+	};
+
+	/**
+	 * @struct message_header_layout
+	 * @brief Message header following the 12-byte prefix of every message
+	*/
+	struct message_header_layout{
+		BigEndian<uint16_t> message_size;       // Halfwords (65535 when the segment fields hold the size instead)
+		BigEndian<uint8_t> rda_channel;
+		BigEndian<uint8_t> message_type;
+		BigEndian<uint16_t> sequence_num;
+		BigEndian<uint16_t> julian_date;
+		BigEndian<uint32_t> milliseconds;
+		BigEndian<uint16_t> segment_count;      // Most significant halfword of the size in bytes for large messages
+		BigEndian<uint16_t> segment_num;        // Least significant halfword of the size in bytes for large messages
+	};
+
+	/**
+	 * @struct message31_header_layout
+	 * @brief Message 31 header up to the reflectivity data block pointer
+	*/
+	struct message31_header_layout{
+		char icao[4];
+		BigEndian<uint32_t> collection_time;
+		BigEndian<uint16_t> julian_date;
+		BigEndian<uint16_t> azimuth_num;
+		BigEndian<float> azimuth_angle;
+		BigEndian<uint8_t> compression;
+		BigEndian<uint8_t> spare;
+		BigEndian<uint16_t> radial_length;
+		BigEndian<uint8_t> azimuth_spacing;
+		BigEndian<uint8_t> radial_status;
+		BigEndian<uint8_t> elevation_num;
+		BigEndian<uint8_t> cut_sector;
+		BigEndian<float> elevation_angle;
+		BigEndian<uint8_t> spot_blanking;
+		BigEndian<uint8_t> azimuth_indexing;
+		BigEndian<uint16_t> data_block_count;
+		BigEndian<uint32_t> ptr_vol_const;
+		BigEndian<uint32_t> ptr_elv_const;
+		BigEndian<uint32_t> ptr_rad_const;
+		BigEndian<uint32_t> ptr_ref_block;
+	};
+
+	/**
+	 * @struct moment_block_layout
+	 * @brief Generic moment data block header (e.g. "DREF"), followed by the gates
+	*/
+	struct moment_block_layout{
+		char type_name[4];
+		BigEndian<uint32_t> reserved;
+		BigEndian<uint16_t> num_gates;
+		BigEndian<uint16_t> range;              // Kilometers, 0.001 precision
+		BigEndian<uint16_t> range_interval;     // Kilometers, 0.001 precision
+		BigEndian<uint16_t> tover;              // 0.1 precision
+		BigEndian<int16_t> snr_threshold;       // 0.125 precision
+		BigEndian<uint8_t> control_flags;
+		BigEndian<uint8_t> word_size;
+		BigEndian<float> scale;
+		BigEndian<float> offset;
+	};
+
+	// Offsets and sizes follow the ICD, any padding would break them
+	static_assert(sizeof(message_header_layout) == 16 && alignof(message_header_layout) == 1, "Message header is 16 bytes");
+	static_assert(offsetof(message_header_layout, message_type) == 3, "Message type is byte 3 of the message header");
+	static_assert(offsetof(message_header_layout, segment_count) == 12, "Segment fields close the message header");
+	static_assert(sizeof(message31_header_layout) == 48 && alignof(message31_header_layout) == 1, "Message 31 header is 48 bytes up to the REF pointer");
+	static_assert(offsetof(message31_header_layout, azimuth_num) == 10, "Azimuth number follows the collection date");
+	static_assert(offsetof(message31_header_layout, elevation_angle) == 24, "Elevation angle follows the cut sector");
+	static_assert(offsetof(message31_header_layout, data_block_count) == 30, "Data block count precedes the block pointers");
+	static_assert(offsetof(message31_header_layout, ptr_ref_block) == 44, "REF pointer is the fourth block pointer");
+	static_assert(sizeof(moment_block_layout) == 28 && alignof(moment_block_layout) == 1, "Moment data block header is 28 bytes");
+	static_assert(offsetof(moment_block_layout, num_gates) == 8, "Gate count follows the block name and reserved word");
+	static_assert(offsetof(moment_block_layout, word_size) == 19, "Word size precedes the scale and offset");
+}
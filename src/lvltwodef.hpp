@@ -12,6 +12,8 @@
 #include <array>
 #include <variant>	
 
+#include "diagnostics.hpp"
+
 enum class MomentType {REF, VEL, SW};
 
 /**
@@ -118,6 +120,81 @@ typedef struct {
 	std::unique_ptr<radial> ref;
 } radial_data;
 
+/**
+ * @struct
+ * @brief A struct viewing the gates of one data moment in place, without converting them
+ * @member gates
+ * Member 'gates' is a pointer to the first recorded gate within the decompressed archive, 16-bit gates being big endian (nullptr when the moment is missing)
+ * @member num_gates
+ * Member 'num_gates' is an integer denoting the number of gates in the radial
+ * @member word_size
+ * Member 'word_size' is the number of bits per recorded gate
+ * @member range
+ * Member 'range' is a float denoting the range (km) to first gate
+ * @member range_interval
+ * Member 'range_interval' is a float denoting the interval (km) between gates
+ * @member snr
+ * Member 'snr' is a float indicating the signal to noise ratio
+ * @member scale
+ * Member 'scale' is a float denoting the scale used in translating real values to recorded values
+ * @member offset
+ * Member 'offset' is a float denoting the offset used in translating real values to recorded values (true value is (recorded + offset) / scale,
+ * recorded values 0 and 1 being below threshold and range folded)
+ */
+typedef struct {
+	const uint8_t *gates;
+	uint16_t num_gates;
+	uint8_t word_size;
+	float range;
+	float range_interval;
+	float snr;
+	float scale;
+	float offset;
+} moment_view;
+
+/**
+ * @struct
+ * @brief A struct viewing one radial (Message 31) in place, filled without any allocation
+ * @member azimuth
+ * Member 'azimuth' is a float denoting the azimuth angle of the radial
+ * @member azimuth_num
+ * Member 'azimuth_num' is an integer denoting which (index) of the azimuth angle
+ * @member elevation
+ * Member 'elevation' is a float denoting the elevation angle of the radial
+ * @member elevation_num
+ * Member 'elevation_num' is an integer denoting the index of elevation
+ * @member radial_length
+ * Member 'radial_length' is an integer denoting length of radial in bytes
+ * @member radial_status
+ * Member 'radial_status' is an integer denoting the radial status
+ * @member num_data_blocks
+ * Member 'num_data_blocks' is an integer denoting how many data blocks are in the radial
+ * @member ptr_x_y
+ * Member 'ptr_x_y' is a pointer to x product/property and y denotes either constant or data block
+ * @member azimuth_spacing
+ * Member 'azimuth_spacing' is a bool denoting azimuth spacing resolution (true=1.0, false=0.5)
+ * @member offset
+ * Member 'offset' is the position of the message frame within the decompressed archive
+ * @member ref
+ * Member 'ref' is a moment_view of the reflectivity gates (gates is nullptr when the radial has no readable REF block)
+ */
+typedef struct {
+	float azimuth;
+	uint16_t azimuth_num;
+	float elevation;
+	uint8_t elevation_num;
+	uint16_t radial_length;
+	uint8_t radial_status;
+	uint16_t num_data_blocks;
+	uint32_t ptr_vol_const;
+	uint32_t ptr_elv_const;
+	uint32_t ptr_rad_const;
+	uint32_t ptr_ref_block;
+	bool azimuth_spacing;
+	uint64_t offset;
+	moment_view ref;
+} radial_view;
+
 /**
  * @struct
  * @brief A struct to hold all radials of a given elevation
@@ -141,13 +218,139 @@ typedef struct {
  * Member 'header' is a volume_header struct to hold information about the volume header 
  * @member metadata
  * Member 'metadata' is a metadata_record struct to hold information about the volume metadata
+ * @member partial
+ * Member 'partial' is whether damaged LDM records were skipped, so the volume is missing radials
+ * @member bad_records
+ * Member 'bad_records' is a vector of the indices of the skipped (damaged) LDM records, in order
+ * @member diagnostics
+ * Member 'diagnostics' collects the problems found while decoding messages (counted and kept, never printed unless echo is turned on)
 */
 typedef struct{
 	std::unique_ptr<volume_header> header;
 	std::unique_ptr<metadata_record> metadata;
 	std::array<std::shared_ptr<elevation_head>, 33> scan_elevations;
+	bool partial = false;
+	std::vector<size_t> bad_records;
+	Decoder::Diagnostics diagnostics;
 } archive_file;
 
+/**
+ * @struct
+ * @brief A struct to hold the location of one LDM record within an archive file
+ * @member offset
+ * Member 'offset' is the byte offset of the record contents (the bzip2 stream for compressed records)
+ * @member size
+ * Member 'size' is the number of bytes of record contents starting from offset
+ * @member compressed
+ * Member 'compressed' is a bool denoting whether the record contents are bzip2 compressed (false for bytes passed through as-is)
+ */
+typedef struct {
+	uint64_t offset;
+	uint64_t size;
+	bool compressed;
+} ldm_record;
+
+/**
+ * @brief A struct to hold the location of one volume within a stream of concatenated volumes
+ * @member offset
+ * Member 'offset' is the byte offset of the volume header
+ * @member size
+ * Member 'size' is the number of bytes of the volume, from its header up to the next volume (or the end of the stream)
+ */
+typedef struct {
+	uint64_t offset;
+	uint64_t size;
+} volume_span;
+
+/**
+ * @brief A struct to hold the location of one message within a (decompressed) archive, as recorded in a message index
+ * @member offset
+ * Member 'offset' is the position of the message frame (its 12-byte prefix) within the decompressed archive
+ * @member size
+ * Member 'size' is the number of bytes from the frame start to the end of the message
+ * @member type
+ * Member 'type' is the message type
+ * @member elevation_num
+ * Member 'elevation_num' is the elevation number of a Message 31 (0 for other messages)
+ * @member azimuth_num
+ * Member 'azimuth_num' is the azimuth number of a Message 31 (0 for other messages)
+ */
+typedef struct {
+	uint64_t offset;
+	uint32_t size;
+	uint8_t type;
+	uint8_t elevation_num;
+	uint16_t azimuth_num;
+} message_entry;
+
+/**
+ * @struct
+ * @brief A struct to hold the identifying information of an archive, read without decoding any radials
+ * @member icao
+ * Member 'icao' is a string containing the radar site icao
+ * @member version
+ * Member 'version' holds the version of the radar data
+ * @member extension_num
+ * Member 'extension_num' holds the potentially rolled-over number of queued radar data volumes
+ * @member date
+ * Member 'date' contains the NEXRAD-modified Julian date of the start
+ * @member time
+ * Member 'time' contains the number of milliseconds past midnight
+ * @member vcp
+ * Member 'vcp' is the volume coverage pattern number from Message 5 (0 when no Message 5 was found)
+*/
+typedef struct {
+	std::string icao;
+	uint8_t version;
+	uint8_t extension_num;
+	uint32_t date;
+	uint32_t time;
+	uint16_t vcp;
+} archive_summary;
+
+constexpr uint64_t VOLUME_HEADER_SIZE = 24;
+
 constexpr size_t BZIP2_DECOMPRESS_BUFSIZE = 1000000;
 
-constexpr uint8_t MESSAGE_TYPE_31 = 31;
\ No newline at end of file
+// 48-bit magic numbers starting each (bit-aligned) bzip2 block, and ending each bzip2 stream
+constexpr uint64_t BZIP2_BLOCK_MAGIC = 0x314159265359ULL;
+constexpr uint64_t BZIP2_END_MAGIC = 0x177245385090ULL;
+
+// An LDM record decompresses to a few MB at most, so a record growing past this is treated as corrupt
+constexpr size_t BZIP2_MAX_RECORD_SIZE = 1 << 27;
+
+constexpr size_t GZIP_READ_BUFSIZE = 1 << 20;
+
+// 10-byte Gzip header plus the 8-byte CRC32/ISIZE trailer
+constexpr size_t GZIP_MIN_SIZE = 18;
+
+// Deflate expands at most 1032:1, and no volume comes near 512 MB, so ISIZE trailers past either only presize up to these bounds
+constexpr uint64_t GZIP_MAX_RATIO = 1032;
+constexpr uint64_t GZIP_MAX_SIZE_HINT = 1ULL << 29;
+
+// Tar bundles are made of 512-byte blocks (member headers, and member data padded to a whole block)
+constexpr size_t TAR_BLOCK_SIZE = 512;
+
+constexpr uint8_t MESSAGE_TYPE_5 = 5;
+constexpr uint8_t MESSAGE_TYPE_31 = 31;
+
+// 12 bytes (CTM) preceding every message, followed by the 16 byte message header
+constexpr uint64_t MESSAGE_PREFIX_SIZE = 12;
+constexpr uint64_t MESSAGE_HEADER_SIZE = 16;
+
+// Every message other than Message 31 occupies a fixed size frame (including the prefix)
+constexpr uint64_t MESSAGE_FRAME_SIZE = 2432;
+
+constexpr uint64_t METADATA_RECORD_SIZE = 325888;
+
+// Message index files start with this magic and format version, then the decompressed archive size and the entry count
+constexpr char MESSAGE_INDEX_MAGIC[4] = {'O', 'R', 'M', 'I'};
+constexpr uint32_t MESSAGE_INDEX_VERSION = 2;
+
+// Message 31 radial status values
+constexpr uint8_t RADIAL_STATUS_START_ELEVATION = 0;
+constexpr uint8_t RADIAL_STATUS_INTERMEDIATE = 1;
+constexpr uint8_t RADIAL_STATUS_END_ELEVATION = 2;
+constexpr uint8_t RADIAL_STATUS_START_VOLUME = 3;
+constexpr uint8_t RADIAL_STATUS_END_VOLUME = 4;
+constexpr uint8_t RADIAL_STATUS_START_LAST_ELEVATION = 5;
\ No newline at end of file
@@ -0,0 +1,45 @@
+#include <string>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "mapped_file.hpp"
+
+
+Decoder::MappedFile::~MappedFile(){
+#if defined(__unix__) || defined(__APPLE__)
+	if(mapping != nullptr) munmap(mapping, length);
+#endif
+}
+
+int Decoder::MappedFile::open(const std::string &file_name){
+#if defined(__unix__) || defined(__APPLE__)
+	if(mapping != nullptr) return -1;
+
+	int fd = ::open(file_name.c_str(), O_RDONLY);
+	if(fd < 0) return -1;
+
+	struct stat info;
+	if(fstat(fd, &info) < 0 || info.st_size <= 0){
+		close(fd);
+		return -1;
+	}
+
+	void *mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// Mapping holds its own reference to the file
+	close(fd);
+	if(mapped == MAP_FAILED) return -1;
+
+	madvise(mapped, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+
+	mapping = mapped;
+	length = static_cast<size_t>(info.st_size);
+	return 0;
+#else
+	return -1;
+#endif
+}
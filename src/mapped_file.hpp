@@ -0,0 +1,54 @@
+/**
+ * @file mapped_file.hpp
+ * @brief Header file for a read-only memory mapped file
+ * @author Owen Capell
+*/
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * @namespace Decoder
+ * @brief Encapsulate decoding functions
+*/
+namespace Decoder
+{
+	/**
+	 * @class MappedFile
+	 * @brief A read-only, private memory mapping of an entire file that is unmapped on destruction
+	*/
+	class MappedFile{
+	private:
+		void *mapping;
+		size_t length;
+
+	public:
+		MappedFile() : mapping(nullptr), length(0) {}
+		~MappedFile();
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+
+		/**
+		 * @brief Maps the given file into memory, advising the kernel it will be read sequentially
+		 * @param file_name Name of the file to map
+		 * @return 0 on success, -1 on any error (including empty files and platforms without mmap)
+		*/
+		int open(const std::string &file_name);
+
+		/**
+		 * @brief Tells the start of the mapped bytes
+		 * @returns Pointer to the first mapped byte (nullptr if not mapped)
+		*/
+		const uint8_t *data() const { return static_cast<const uint8_t*>(mapping); }
+
+		/**
+		 * @brief Tells the size of the mapping
+		 * @returns Number of mapped bytes
+		*/
+		size_t size() const { return length; }
+	};
+}
@@ -0,0 +1,134 @@
+/**
+ * @file message_cursor.hpp
+ * @brief Header file for a cursor over the bytes of one message, bounds checked once up front rather than on every read
+ * @author Owen Capell
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+#include <string_view>
+#include <type_traits>
+
+#include "byte_swap.hpp"
+
+/**
+ * @namespace Decoder
+ * @brief Encapsulate decoding functions
+*/
+namespace Decoder
+{
+	/**
+	 * @class MessageCursor
+	 * @brief A cursor over a contiguous, already validated byte range (e.g. one Message 31). Callers check that a field or block fits
+	 * once with fits, then read it without further checks (debug builds still assert every read)
+	*/
+	class MessageCursor{
+	private:
+		const uint8_t *bytes;
+		size_t length;
+		size_t pointer;
+
+	public:
+		/**
+		 * @brief Constructor for an empty cursor
+		*/
+		MessageCursor() : bytes(nullptr), length(0), pointer(0) {}
+
+		/**
+		 * @brief Constructor accepting the range to read (e.g. from ArchiveFile::view), which must outlive the cursor
+		 * @param range Bytes of the message
+		*/
+		explicit MessageCursor(std::string_view range)
+			: bytes(reinterpret_cast<const uint8_t*>(range.data())), length(range.size()), pointer(0) {}
+
+		/**
+		 * @brief Tells whether len bytes starting from pos lie within the range
+		 * @returns Boolean indicator of whether the bytes fit
+		*/
+		bool fits(size_t pos, size_t len) const { return pos <= length && len <= length - pos; }
+
+		/**
+		 * @brief Tells the range size
+		 * @returns Number of bytes in the range
+		*/
+		size_t size() const { return length; }
+
+		/**
+		 * @brief Tells the position of the cursor within the range
+		 * @returns Position of the cursor
+		*/
+		size_t position() const { return pointer; }
+
+		/**
+		 * @brief Moves the cursor (unchecked, pos must be within the range)
+		 * @param pos New position
+		*/
+		void seek(size_t pos){
+			assert(pos <= length);
+			pointer = pos;
+		}
+
+		/**
+		 * @brief Skips bytes (unchecked, they must be within the range)
+		 * @param off Number of bytes to skip
+		*/
+		void ignore(size_t off){
+			assert(fits(pointer, off));
+			pointer += off;
+		}
+
+		/**
+		 * @brief Reads a big endian integral value (unchecked, it must be within the range)
+		 * @tparam T Integral type
+		 * @return Value in host order
+		*/
+		template <typename T>
+		T readIntegral(){
+			assert(fits(pointer, sizeof(T)));
+			T value;
+			std::memcpy(&value, bytes + pointer, sizeof(T));
+			pointer += sizeof(T);
+			return reverseEndian(value);
+		}
+
+		/**
+		 * @brief Reads a big endian float (unchecked, it must be within the range)
+		 * @return Value in host order
+		*/
+		float readFloat(){
+			uint32_t raw = readIntegral<uint32_t>();
+			float value;
+			std::memcpy(&value, &raw, sizeof(raw));
+			return value;
+		}
+
+		/**
+		 * @brief Reads a whole fixed layout (see layout.hpp, unchecked, it must be within the range)
+		 * @tparam T Layout type (byte aligned, trivially copyable)
+		 * @param layout Reference to the layout to read into
+		*/
+		template <typename T>
+		void readLayout(T &layout){
+			static_assert(std::is_trivially_copyable<T>::value && alignof(T) == 1, "Layouts are byte aligned and trivially copyable");
+			assert(fits(pointer, sizeof(T)));
+			std::memcpy(&layout, bytes + pointer, sizeof(T));
+			pointer += sizeof(T);
+		}
+
+		/**
+		 * @brief Takes len bytes in place (unchecked, they must be within the range)
+		 * @param len Number of bytes to take
+		 * @return Pointer to the first byte taken
+		*/
+		const uint8_t* take(size_t len){
+			assert(fits(pointer, len));
+			const uint8_t *taken = bytes + pointer;
+			pointer += len;
+			return taken;
+		}
+	};
+}
@@ -0,0 +1,169 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+
+#include "decoder.hpp"
+#include "lvltwodef.hpp"
+
+// Index files hold a header (magic, version, the archive identity, message count), then 16 bytes per message, all big endian like the archive itself
+constexpr size_t MESSAGE_INDEX_IDENTITY_SIZE = 8 + VOLUME_HEADER_SIZE + 8;
+constexpr size_t MESSAGE_INDEX_HEADER_SIZE = 8 + MESSAGE_INDEX_IDENTITY_SIZE + 8;
+constexpr size_t MESSAGE_INDEX_ENTRY_SIZE = 16;
+
+
+/**
+ * @brief Writes an integral value big endian
+*/
+template <typename T>
+static uint8_t* putBigEndian(uint8_t *out, T value){
+	for(size_t i=0; i<sizeof(T); i++) out[i] = static_cast<uint8_t>(value >> (8 * (sizeof(T)-1-i)));
+	return out + sizeof(T);
+}
+
+/**
+ * @brief Reads a big endian integral value
+*/
+template <typename T>
+static const uint8_t* getBigEndian(const uint8_t *in, T &value){
+	value = 0;
+	for(size_t i=0; i<sizeof(T); i++) value = static_cast<T>((value << 8) | in[i]);
+	return in + sizeof(T);
+}
+
+/**
+ * @brief Writes what identifies an archive: its size, its volume header (ICAO, date and time) and a hash of its metadata record
+ * Volumes of one site and VCP often share a size, so the size alone cannot tell them apart
+*/
+static void putIdentity(uint8_t *out, Decoder::ArchiveFile &archive){
+	out = putBigEndian(out, static_cast<uint64_t>(archive.size()));
+	std::string_view header = archive.view(0, VOLUME_HEADER_SIZE);
+	std::memcpy(out, header.data(), header.size());
+	out += VOLUME_HEADER_SIZE;
+	std::string_view metadata = archive.view(VOLUME_HEADER_SIZE, METADATA_RECORD_SIZE);
+	putBigEndian(out, Decoder::RecordCache::hash(reinterpret_cast<const uint8_t*>(metadata.data()), metadata.size()));
+}
+
+int Decoder::BuildMessageIndex(ArchiveFile &archive, std::vector<message_entry> &index){
+	index.clear();
+	if(archive.view(0, 6) != "AR2V00"){
+		std::cerr << "File is either corrupt or not a NEXRAD Level 2 archive file." << std::endl;
+		return -1;
+	}
+
+	// Metadata messages follow the volume header directly, so one walk covers them and the radials
+	uint64_t saved = archive.position();
+	archive.seek(VOLUME_HEADER_SIZE);
+	int status = 0;
+	while(!archive.at_end()){
+		uint64_t frame_start_pos = archive.position();
+		message_header_layout header;
+		uint64_t message_end;
+		int read = Decoder::ReadMessageHeader(archive, header, message_end);
+		if(read < 0) status = -1;
+		// Malformed message, or trailing bytes too short to be one
+		if(read != 0) break;
+
+		message_entry entry = {frame_start_pos, static_cast<uint32_t>(message_end - frame_start_pos), header.message_type.get(), 0, 0};
+		if(entry.type == MESSAGE_TYPE_31){
+			message31_header_layout radial;
+			if(archive.readLayout(radial) == sizeof(radial)){
+				entry.elevation_num = radial.elevation_num.get();
+				entry.azimuth_num = radial.azimuth_num.get();
+			}
+		}
+		index.push_back(entry);
+		archive.seek(message_end);
+	}
+	archive.seek(saved);
+
+	if(status < 0) std::cerr << "Malformed message header at message #" << index.size()+1 << ", index is incomplete." << std::endl;
+	return status;
+}
+
+int Decoder::SaveMessageIndex(const std::string &file_name, ArchiveFile &archive, const std::vector<message_entry> &index){
+	std::vector<uint8_t> bytes(MESSAGE_INDEX_HEADER_SIZE + index.size()*MESSAGE_INDEX_ENTRY_SIZE);
+	std::memcpy(bytes.data(), MESSAGE_INDEX_MAGIC, 4);
+	uint8_t *out = putBigEndian(bytes.data()+4, MESSAGE_INDEX_VERSION);
+	putIdentity(out, archive);
+	out += MESSAGE_INDEX_IDENTITY_SIZE;
+	out = putBigEndian(out, static_cast<uint64_t>(index.size()));
+	for(const message_entry &entry : index){
+		out = putBigEndian(out, entry.offset);
+		out = putBigEndian(out, entry.size);
+		out = putBigEndian(out, entry.type);
+		out = putBigEndian(out, entry.elevation_num);
+		out = putBigEndian(out, entry.azimuth_num);
+	}
+
+	std::ofstream file(file_name, std::ios::out | std::ios::binary);
+	file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+	file.close();
+	if(!file.good()){
+		std::cerr << "Unable to write message index " << file_name << std::endl;
+		return -1;
+	}
+	return 0;
+}
+
+int Decoder::LoadMessageIndex(const std::string &file_name, ArchiveFile &archive, std::vector<message_entry> &index){
+	index.clear();
+	std::ifstream file(file_name, std::ios::in | std::ios::binary);
+	uint8_t header[MESSAGE_INDEX_HEADER_SIZE];
+	if(!file.read(reinterpret_cast<char*>(header), sizeof(header))) return -1;
+
+	uint32_t version;
+	uint64_t count;
+	const uint8_t *in = getBigEndian(header+4, version);
+	getBigEndian(in + MESSAGE_INDEX_IDENTITY_SIZE, count);
+	if(std::memcmp(header, MESSAGE_INDEX_MAGIC, 4) != 0 || version != MESSAGE_INDEX_VERSION){
+		std::cerr << file_name << " is not a message index." << std::endl;
+		return -1;
+	}
+	// An index of another archive would send every seek to the wrong place
+	uint8_t identity[MESSAGE_INDEX_IDENTITY_SIZE] = {};
+	putIdentity(identity, archive);
+	if(std::memcmp(in, identity, sizeof(identity)) != 0){
+		std::cerr << "Message index " << file_name << " was built from a different archive." << std::endl;
+		return -1;
+	}
+	uint64_t archive_size = archive.size();
+	if(count > archive_size / (MESSAGE_PREFIX_SIZE + MESSAGE_HEADER_SIZE)) return -1;
+
+	std::vector<uint8_t> bytes(count*MESSAGE_INDEX_ENTRY_SIZE);
+	if(!file.read(reinterpret_cast<char*>(bytes.data()), bytes.size())) return -1;
+	index.resize(count);
+	in = bytes.data();
+	for(message_entry &entry : index){
+		in = getBigEndian(in, entry.offset);
+		in = getBigEndian(in, entry.size);
+		in = getBigEndian(in, entry.type);
+		in = getBigEndian(in, entry.elevation_num);
+		in = getBigEndian(in, entry.azimuth_num);
+		if(entry.offset > archive_size || entry.size > archive_size - entry.offset){
+			index.clear();
+			return -1;
+		}
+	}
+	return 0;
+}
+
+int Decoder::DecodeIndexedMessage(ArchiveFile &archive, const message_entry &entry, archive_file &file){
+	if(entry.type != MESSAGE_TYPE_31) return 0;
+	uint64_t begin_header_pos = entry.offset + MESSAGE_PREFIX_SIZE + MESSAGE_HEADER_SIZE;
+	if(entry.size < MESSAGE_PREFIX_SIZE + MESSAGE_HEADER_SIZE || entry.offset > archive.size() || entry.size > archive.size() - entry.offset) return -1;
+
+	MessageCursor cursor(archive.view(begin_header_pos, entry.offset + entry.size - begin_header_pos));
+	return Decoder::Message31::ParseMessage31(cursor, file) < 0 ? -1 : 0;
+}
+
+int Decoder::DecodeIndexedElevation(ArchiveFile &archive, const std::vector<message_entry> &index, uint8_t elevation_num, archive_file &file){
+	bool found = false;
+	for(const message_entry &entry : index){
+		if(entry.type != MESSAGE_TYPE_31 || entry.elevation_num != elevation_num) continue;
+		if(Decoder::DecodeIndexedMessage(archive, entry, file) < 0) return -1;
+		found = true;
+	}
+	return found ? 0 : -1;
+}
@@ -0,0 +1,123 @@
+/**
+ * @file parallel.hpp
+ * @brief Header file for the small threading helpers used by the decoder
+ * @author Owen Capell
+*/
+
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+/**
+ * @namespace Decoder
+ * @brief Encapsulate decoding functions
+*/
+namespace Decoder
+{
+	/**
+	 * @brief Resolves a requested thread count, where 0 means one thread per hardware core
+	 * @param threads Requested number of threads
+	 * @return Number of threads to use (always at least 1)
+	*/
+	inline unsigned int resolveThreads(unsigned int threads){
+		if(threads == 0) threads = std::thread::hardware_concurrency();
+		return std::max(1u, threads);
+	}
+
+	/**
+	 * @brief Runs fn(i) for every i in [0, count) on a pool of worker threads
+	 * Work items are handed out through a shared atomic counter, so uneven items balance out
+	 * @tparam F Callable taking a size_t index
+	 * @param count Number of work items
+	 * @param threads Number of worker threads (0 for one per hardware core)
+	 * @param fn Callable to run for each index
+	*/
+	template <typename F>
+	void parallelFor(size_t count, unsigned int threads, F &&fn){
+		size_t workers = std::min<size_t>(resolveThreads(threads), count);
+		if(workers <= 1){
+			for(size_t i=0; i<count; i++) fn(i);
+			return;
+		}
+
+		std::atomic<size_t> next(0);
+		auto work = [&](){
+			for(size_t i=next++; i<count; i=next++) fn(i);
+		};
+
+		std::vector<std::thread> pool;
+		pool.reserve(workers-1);
+		for(size_t t=0; t<workers-1; t++) pool.emplace_back(work);
+		// Calling thread takes part in the work as well
+		work();
+		for(std::thread &worker : pool) worker.join();
+	}
+
+	/**
+	 * @class BoundedQueue
+	 * @brief A blocking first-in first-out queue holding at most a fixed number of items, used to hand work between pipeline stages
+	 * @tparam T Item type (moved in and out of the queue)
+	*/
+	template <typename T>
+	class BoundedQueue{
+	private:
+		std::deque<T> items;
+		size_t capacity;
+		bool closed;
+		std::mutex lock;
+		std::condition_variable not_empty;
+		std::condition_variable not_full;
+
+	public:
+		/**
+		 * @brief Constructor accepting the maximum number of queued items
+		 * @param capacity Maximum number of queued items (at least 1)
+		*/
+		explicit BoundedQueue(size_t capacity) : capacity(std::max<size_t>(1, capacity)), closed(false) {}
+
+		/**
+		 * @brief Adds an item, waiting while the queue is full
+		 * @param item Item to add
+		 * @return Boolean indicator of whether the item was added (false once the queue is closed)
+		*/
+		bool push(T item){
+			std::unique_lock<std::mutex> guard(lock);
+			not_full.wait(guard, [this](){ return closed || items.size() < capacity; });
+			if(closed) return false;
+			items.push_back(std::move(item));
+			not_empty.notify_one();
+			return true;
+		}
+
+		/**
+		 * @brief Removes the oldest item, waiting while the queue is empty
+		 * @param item Reference to store the removed item in
+		 * @return Boolean indicator of whether an item was removed (false once the queue is closed and drained)
+		*/
+		bool pop(T &item){
+			std::unique_lock<std::mutex> guard(lock);
+			not_empty.wait(guard, [this](){ return closed || !items.empty(); });
+			if(items.empty()) return false;
+			item = std::move(items.front());
+			items.pop_front();
+			not_full.notify_one();
+			return true;
+		}
+
+		/**
+		 * @brief Closes the queue, so pushes fail and pops fail once the remaining items are drained
+		*/
+		void close(){
+			std::lock_guard<std::mutex> guard(lock);
+			closed = true;
+			not_empty.notify_all();
+			not_full.notify_all();
+		}
+	};
+}
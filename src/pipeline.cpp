@@ -0,0 +1,119 @@
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <array>
+#include <cstring>
+#include <variant>
+
+#include "decoder.hpp"
+#include "lvltwodef.hpp"
+#include "parallel.hpp"
+
+
+int Decoder::DecodePipelined(const uint8_t *in, uint64_t in_size, archive_file &file, const ArchiveOptions &options){
+	// A whole archive wrapped in bzip2 is unwrapped up front, its LDM records are then pipelined as usual
+	std::vector<uint8_t> unwrapped;
+	if(options.bzip && in_size >= 10 && std::memcmp(in, "BZh", 3) == 0 && std::memcmp(in+4, "1AY&SY", 6) == 0){
+		if(ArchiveFile::decompressBzip2Stream(in, in_size, unwrapped, options.threads, options.pool.get()) < 0) return -1;
+		in = unwrapped.data();
+		in_size = unwrapped.size();
+	}
+
+	std::vector<ldm_record> records;
+	if(!options.bzip) records.push_back({0, in_size, false});
+	else if(ArchiveFile::walkRecords(in, in_size, records) < 0){
+		if(!options.recover){
+			std::cerr << "Malformed LDM record control word. Archive file may be corrupt." << std::endl;
+			return -1;
+		}
+		ArchiveFile::scanRecords(in, in_size, records);
+	}
+
+	// Decompression stage: produce records, in order, until the parser stops taking them (cache hits travel as their mapping)
+	BoundedQueue<std::variant<std::vector<uint8_t>, RecordCache::Entry>> queue(options.pipeline_depth);
+	std::atomic<bool> failed(false);
+	std::vector<size_t> bad_records;
+	std::thread decompressor([&](){
+		for(size_t i=0; i<records.size(); i++){
+			const ldm_record &record = records[i];
+			RecordCache::Entry cached = (options.cache && record.compressed) ? options.cache->lookup(in+record.offset, record.size) : RecordCache::Entry();
+			if(cached.mapping){
+				if(!queue.push(std::move(cached))) break;
+				continue;
+			}
+			std::vector<uint8_t> block = options.pool ? options.pool->acquire(BZIP2_DECOMPRESS_BUFSIZE) : std::vector<uint8_t>();
+			if(!record.compressed) block.assign(in+record.offset, in+record.offset+record.size);
+			else if(ArchiveFile::decompressBzip2(in+record.offset, record.size, block) < 0){
+				if(options.pool) options.pool->recycle(std::move(block));
+				if(options.recover){
+					// Skip the damaged record, the parser never sees it
+					bad_records.push_back(i);
+					continue;
+				}
+				failed = true;
+				break;
+			}
+			else if(options.cache) options.cache->store(in+record.offset, record.size, block.data(), block.size());
+			if(!queue.push(std::move(block))) break;
+		}
+		queue.close();
+	});
+
+	// Requested elevations still to complete (none requested means decode everything)
+	std::array<bool, 33> wanted;
+	wanted.fill(options.elevations.empty());
+	size_t remaining = 0;
+	for(uint8_t elevation : options.elevations){
+		if(elevation < wanted.size() && !wanted[elevation]){
+			wanted[elevation] = true;
+			remaining++;
+		}
+	}
+	auto on_elevation = [&](const std::shared_ptr<elevation_head> &elevation){
+		if(!options.elevations.empty() && wanted[elevation->elevation_num]) remaining--;
+	};
+
+	// Parse stage: records arrive already decompressed (or mapped from the cache) and are adopted without copying
+	Decoder::ChunkDecoder decoder(file, on_elevation, options);
+
+	int status = 0;
+	bool stopped = false;
+	std::variant<std::vector<uint8_t>, RecordCache::Entry> block;
+	while(queue.pop(block)){
+		// The decompressor must be stopped and joined before leaving, so a throwing parse (e.g. a malformed volume header) is a failed decode
+		try{
+			status = std::visit([&](auto &&record){ return decoder.push(std::move(record)); }, std::move(block));
+		}
+		catch(const std::exception &e){
+			std::cerr << "Error decoding archive: " << e.what() << std::endl;
+			status = -1;
+		}
+		if(status < 0){
+			queue.close();
+			break;
+		}
+		block = std::vector<uint8_t>();
+
+		// Every requested elevation is complete, so the remaining records are never decompressed
+		if(!options.elevations.empty() && remaining == 0){
+			stopped = true;
+			queue.close();
+			break;
+		}
+	}
+	decompressor.join();
+
+	if(failed) return -1;
+	if(status < 0) return status;
+	if(!options.elevations.empty()){
+		for(size_t i=0; i<wanted.size(); i++){
+			if(!wanted[i]) file.scan_elevations[i] = nullptr;
+		}
+	}
+	status = stopped ? 0 : decoder.finish();
+	file.bad_records = bad_records;
+	file.partial = !bad_records.empty();
+	return status;
+}
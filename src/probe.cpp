@@ -0,0 +1,137 @@
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <cstdlib>
+#include <functional>
+
+#include <zlib.h>
+
+#include "decoder.hpp"
+#include "lvltwodef.hpp"
+
+
+/**
+ * @brief Reads the volume header and first LDM record through a reader, then picks the summary out of them
+ * @param read_exact Callable reading exactly the requested number of bytes, returning false when the input ends first
+ * @param summary A reference to an archive_summary struct to write to
+ * @return 0 on success, -1 on any error, -2 if no Message 5 was found
+*/
+static int probeRecords(const std::function<bool(uint8_t*, size_t)> &read_exact, archive_summary &summary){
+	// Volume header, the first record's control word and (for compressed archives) the bzip2 stream magic
+	std::vector<uint8_t> bytes(VOLUME_HEADER_SIZE + 7);
+	if(!read_exact(bytes.data(), bytes.size())){
+		std::cerr << "Archive too short to hold a volume header and LDM record." << std::endl;
+		return -1;
+	}
+
+	const uint8_t *word = &bytes[VOLUME_HEADER_SIZE];
+	int32_t control_word = static_cast<int32_t>(
+		(static_cast<uint32_t>(word[0]) << 24) |
+		(static_cast<uint32_t>(word[1]) << 16) |
+		(static_cast<uint32_t>(word[2]) << 8) |
+		static_cast<uint32_t>(word[3])
+	);
+	uint64_t record_size = static_cast<uint64_t>(std::abs(static_cast<int64_t>(control_word)));
+
+	if(std::memcmp(word+4, "BZh", 3) == 0 && record_size >= 3 && record_size <= BZIP2_MAX_RECORD_SIZE){
+		// Only the first (metadata) record is read and decompressed
+		std::vector<uint8_t> compressed(record_size);
+		std::memcpy(compressed.data(), word+4, 3);
+		if(!read_exact(compressed.data()+3, record_size-3)){
+			std::cerr << "Unexpected EOF in first LDM record." << std::endl;
+			return -1;
+		}
+		std::vector<uint8_t> metadata;
+		if(Decoder::ArchiveFile::decompressBzip2(compressed.data(), compressed.size(), metadata) < 0) return -1;
+		bytes.resize(VOLUME_HEADER_SIZE);
+		bytes.insert(bytes.end(), metadata.begin(), metadata.end());
+	}
+	else{
+		// Already decompressed, so the bytes after the volume header are the metadata record itself
+		bytes.resize(VOLUME_HEADER_SIZE + METADATA_RECORD_SIZE);
+		if(!read_exact(bytes.data() + VOLUME_HEADER_SIZE + 7, METADATA_RECORD_SIZE - 7)){
+			std::cerr << "Unexpected EOF in metadata record." << std::endl;
+			return -1;
+		}
+	}
+
+	// Decode the volume header in place
+	Decoder::ArchiveOptions options;
+	options.gzip = false;
+	options.bzip = false;
+	Decoder::ArchiveFile archive(bytes.data(), bytes.size(), options);
+	std::unique_ptr<volume_header> header = std::make_unique<volume_header>();
+	if(Decoder::DecodeHeader(archive, header) < 0) return -1;
+
+	summary.icao = header->icao;
+	summary.version = header->version;
+	summary.extension_num = header->extension_num;
+	summary.date = header->date;
+	summary.time = header->time;
+	summary.vcp = 0;
+
+	// Metadata messages each occupy a fixed size frame, so check the type of each frame for Message 5
+	for(uint64_t frame = VOLUME_HEADER_SIZE; frame + MESSAGE_PREFIX_SIZE + MESSAGE_HEADER_SIZE + 6 <= archive.size(); frame += MESSAGE_FRAME_SIZE){
+		Decoder::message_header_layout header;
+		archive.seek(frame + MESSAGE_PREFIX_SIZE);
+		archive.readLayout(header);
+		if(header.message_type.get() != MESSAGE_TYPE_5) continue;
+
+		// Message size and pattern type precede the pattern number
+		archive.seek(frame + MESSAGE_PREFIX_SIZE + MESSAGE_HEADER_SIZE + 4);
+		archive.readIntegral(summary.vcp);
+		return 0;
+	}
+
+	return -2;
+}
+
+int Decoder::ProbeArchive(const std::string &file_name, archive_summary &summary){
+	// zlib reads plain files through transparently, so one reader covers both
+	gzFile in = gzopen(file_name.c_str(), "rb");
+	if(in == nullptr){
+		std::cerr << "Unable to open file " << file_name << std::endl;
+		return -1;
+	}
+
+	int status = probeRecords([&](uint8_t *buffer, size_t size){
+		return gzread(in, buffer, size) == static_cast<int>(size);
+	}, summary);
+	gzclose(in);
+	return status;
+}
+
+int Decoder::ProbeArchive(const uint8_t *bytes, size_t size, archive_summary &summary){
+	if(!(size >= GZIP_MIN_SIZE && bytes[0] == 0x1f && bytes[1] == 0x8b)){
+		uint64_t pos = 0;
+		return probeRecords([&](uint8_t *buffer, size_t amt){
+			if(size - pos < amt) return false;
+			std::memcpy(buffer, bytes+pos, amt);
+			pos += amt;
+			return true;
+		}, summary);
+	}
+
+	// Inflate only as far as the first record
+	z_stream stream = {};
+	stream.next_in = const_cast<Bytef*>(bytes);
+	stream.avail_in = size;
+	if(inflateInit2(&stream, 16 + MAX_WBITS) != Z_OK){
+		std::cerr << "Error initializing zlib decompression stream." << std::endl;
+		return -1;
+	}
+
+	bool ended = false;
+	int status = probeRecords([&](uint8_t *buffer, size_t amt){
+		stream.next_out = buffer;
+		stream.avail_out = amt;
+		while(stream.avail_out > 0 && !ended){
+			int ret = inflate(&stream, Z_NO_FLUSH);
+			if(ret == Z_STREAM_END) ended = true;
+			else if(ret != Z_OK) return false;
+		}
+		return stream.avail_out == 0;
+	}, summary);
+	inflateEnd(&stream);
+	return status;
+}
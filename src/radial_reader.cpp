@@ -0,0 +1,55 @@
+#include <iostream>
+#include <string>
+#include <memory>
+#include <utility>
+
+#include "radial_reader.hpp"
+#include "message_cursor.hpp"
+
+
+Decoder::RadialReader::RadialReader(ArchiveFile &archive)
+	: archive(&archive), pointer(VOLUME_HEADER_SIZE + METADATA_RECORD_SIZE), state(0){
+	if(!archive.isInitialized() || archive.view(0, 6) != "AR2V00"){
+		std::cerr << "File is either corrupt or not a NEXRAD Level 2 archive file." << std::endl;
+		state = -1;
+	}
+}
+
+Decoder::RadialReader::RadialReader(std::unique_ptr<ArchiveFile> owned)
+	: RadialReader(*owned){
+	this->owned = std::move(owned);
+}
+
+Decoder::RadialReader::RadialReader(const std::string &file_name, const ArchiveOptions &options)
+	: RadialReader(std::make_unique<ArchiveFile>(file_name, options)) {}
+
+bool Decoder::RadialReader::next(radial_view &view){
+	if(state < 0) return false;
+
+	// Radials are read where they sit, so only the message headers in between are walked
+	while(pointer < archive->size() && archive->size() - pointer >= MESSAGE_PREFIX_SIZE + MESSAGE_HEADER_SIZE){
+		uint64_t frame_start_pos = pointer;
+		archive->seek(frame_start_pos);
+		message_header_layout header;
+		uint64_t message_end_pos;
+		int status = Decoder::ReadMessageHeader(*archive, header, message_end_pos);
+		// Trailing partial message
+		if(status > 0) break;
+		diag.beginMessage(archive->releasedBytes() + frame_start_pos);
+		if(status < 0){
+			diag.report(DiagnosticCode::MALFORMED_MESSAGE_HEADER);
+			state = -1;
+			return false;
+		}
+		pointer = message_end_pos;
+		if(header.message_type.get() != MESSAGE_TYPE_31) continue;
+
+		uint64_t begin_header_pos = frame_start_pos + MESSAGE_PREFIX_SIZE + MESSAGE_HEADER_SIZE;
+		MessageCursor cursor(archive->view(begin_header_pos, message_end_pos - begin_header_pos));
+		if(Decoder::Message31::ReadRadial(cursor, view, diag) < 0) continue;
+		view.offset = frame_start_pos;
+		return true;
+	}
+
+	return false;
+}
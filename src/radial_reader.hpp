@@ -0,0 +1,122 @@
+/**
+ * @file radial_reader.hpp
+ * @brief Header file for pulling radials out of a decompressed archive one at a time, as views into its bytes
+ * @author Owen Capell
+*/
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <iterator>
+#include <cstddef>
+
+#include "decoder.hpp"
+#include "lvltwodef.hpp"
+#include "diagnostics.hpp"
+
+/**
+ * @namespace Decoder
+ * @brief Encapsulate decoding functions
+*/
+namespace Decoder
+{
+	/**
+	 * @class RadialReader
+	 * @brief Walks the messages of a decompressed archive on demand, handing out each radial as a radial_view straight from the archive bytes,
+	 * with no per-radial allocation. A view (and its gate pointers) stays valid until the next radial is read
+	*/
+	class RadialReader{
+	private:
+		std::unique_ptr<ArchiveFile> owned;
+		ArchiveFile *archive;
+		uint64_t pointer;
+		int state;
+		Diagnostics diag;
+
+		/**
+		 * @brief Constructor taking ownership of the archive to read from
+		 * @param owned Archive to read from
+		*/
+		explicit RadialReader(std::unique_ptr<ArchiveFile> owned);
+
+	public:
+		/**
+		 * @class iterator
+		 * @brief Input iterator over the radials of a RadialReader (single pass, advancing it reads the next radial)
+		*/
+		class iterator{
+		private:
+			RadialReader *reader;
+			radial_view current;
+
+		public:
+			typedef std::input_iterator_tag iterator_category;
+			typedef radial_view value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef const radial_view* pointer;
+			typedef const radial_view& reference;
+
+			iterator() : reader(nullptr), current() {}
+			explicit iterator(RadialReader *reader) : reader(reader), current() { ++(*this); }
+
+			reference operator*() const { return current; }
+			pointer operator->() const { return &current; }
+
+			iterator& operator++(){
+				if(reader && !reader->next(current)) reader = nullptr;
+				return *this;
+			}
+
+			bool operator==(const iterator &other) const { return reader == other.reader; }
+			bool operator!=(const iterator &other) const { return reader != other.reader; }
+		};
+
+		/**
+		 * @brief Constructor reading from an already decompressed archive (its internal pointer is moved as radials are read)
+		 * @param archive A reference to an ArchiveFile object to read from, which must outlive the reader
+		*/
+		explicit RadialReader(ArchiveFile &archive);
+
+		/**
+		 * @brief Constructor decompressing an archive file to read from
+		 * @param file_name Name of the archive file
+		 * @param options Options controlling decompression (see ArchiveOptions)
+		*/
+		explicit RadialReader(const std::string &file_name, const ArchiveOptions &options = ArchiveOptions());
+
+		RadialReader(const RadialReader&) = delete;
+		RadialReader& operator=(const RadialReader&) = delete;
+
+		/**
+		 * @brief Reads the next radial
+		 * @param view A reference to a radial_view to fill
+		 * @returns Boolean indicator of whether a radial was read (false at the end of the archive, or on a malformed message, see status)
+		*/
+		bool next(radial_view &view);
+
+		/**
+		 * @brief Tells why reading stopped
+		 * @return 0 while reading or at the end of the archive, -1 if the archive could not be read or a message header is malformed
+		*/
+		int status() const { return state; }
+
+		/**
+		 * @brief Returns the problems found so far
+		 * @return Diagnostics of the read
+		*/
+		const Diagnostics& diagnostics() const { return diag; }
+
+		/**
+		 * @brief Starts iterating from the current position
+		 * @return Iterator at the next radial
+		*/
+		iterator begin(){ return iterator(this); }
+
+		/**
+		 * @brief Returns the end iterator
+		 * @return Iterator past the last radial
+		*/
+		iterator end(){ return iterator(); }
+	};
+}
@@ -0,0 +1,179 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <filesystem>
+
+#include "record_cache.hpp"
+
+// Entries start with this magic, the compressed and payload sizes, then the compressed record (the full key) and the payload
+constexpr char RECORD_CACHE_MAGIC[8] = {'O', 'R', 'R', 'E', 'C', '0', '0', '1'};
+constexpr size_t RECORD_CACHE_HEADER_SIZE = sizeof(RECORD_CACHE_MAGIC) + 2*sizeof(uint64_t);
+
+Decoder::RecordCache::RecordCache(const std::string &directory, uint64_t max_bytes)
+	: directory(directory), max_bytes(max_bytes), approx_bytes(0), temp_counter(0),
+	hits(0), misses(0), stores(0), evictions(0){
+	std::error_code error;
+	std::filesystem::create_directories(directory, error);
+	if(error) std::cerr << "Unable to create record cache directory " << directory << std::endl;
+
+	// Start from what earlier runs left behind
+	for(const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(directory, error)){
+		if(entry.path().extension() != ".rec") continue;
+		uint64_t size = entry.file_size(error);
+		if(error) continue;
+		approx_bytes += size;
+	}
+}
+
+uint64_t Decoder::RecordCache::hash(const uint8_t *bytes, size_t size){
+	// Final mix of MurmurHash3, applied to every 8 bytes and to the result
+	auto mix = [](uint64_t x){
+		x ^= x >> 33;
+		x *= 0xFF51AFD7ED558CCDULL;
+		x ^= x >> 33;
+		x *= 0xC4CEB9FE1A85EC53ULL;
+		x ^= x >> 33;
+		return x;
+	};
+
+	uint64_t h = 0x9E3779B97F4A7C15ULL ^ size;
+	size_t i = 0;
+	for(; i+8 <= size; i+=8){
+		uint64_t word;
+		std::memcpy(&word, bytes+i, 8);
+		h = (h ^ mix(word)) * 0x9E3779B97F4A7C15ULL;
+		h = (h << 31) | (h >> 33);
+	}
+	uint64_t tail = 0;
+	for(; i<size; i++) tail = (tail << 8) | bytes[i];
+	return mix(h ^ mix(tail));
+}
+
+std::string Decoder::RecordCache::entryPath(const uint8_t *compressed, size_t size) const{
+	// Compressed size is part of the key as well, so a hash collision also needs an equal size
+	char name[64];
+	std::snprintf(name, sizeof(name), "%016llx-%llx.rec", static_cast<unsigned long long>(hash(compressed, size)), static_cast<unsigned long long>(size));
+	return (std::filesystem::path(directory) / name).string();
+}
+
+Decoder::RecordCache::Entry Decoder::RecordCache::lookup(const uint8_t *compressed, size_t size){
+	std::string path = entryPath(compressed, size);
+	std::shared_ptr<MappedFile> mapping = std::make_shared<MappedFile>();
+	if(mapping->open(path) < 0){
+		misses++;
+		return Entry();
+	}
+
+	// Only a hit if the entry holds this very record, the name is just a hash
+	uint64_t key_size = 0;
+	uint64_t payload_size = 0;
+	const uint8_t *bytes = mapping->data();
+	if(mapping->size() >= RECORD_CACHE_HEADER_SIZE){
+		std::memcpy(&key_size, bytes + sizeof(RECORD_CACHE_MAGIC), sizeof(key_size));
+		std::memcpy(&payload_size, bytes + sizeof(RECORD_CACHE_MAGIC) + sizeof(key_size), sizeof(payload_size));
+	}
+	bool damaged = mapping->size() < RECORD_CACHE_HEADER_SIZE || std::memcmp(bytes, RECORD_CACHE_MAGIC, sizeof(RECORD_CACHE_MAGIC)) != 0
+		|| key_size > mapping->size() - RECORD_CACHE_HEADER_SIZE || mapping->size() - RECORD_CACHE_HEADER_SIZE - key_size != payload_size;
+	if(damaged || key_size != size || std::memcmp(bytes + RECORD_CACHE_HEADER_SIZE, compressed, size) != 0){
+		// Damaged entries are dropped so the next store can replace them, a colliding record just stays uncached
+		std::error_code error;
+		if(damaged) std::filesystem::remove(path, error);
+		misses++;
+		return Entry();
+	}
+
+	// Refresh the modification time, which eviction orders entries by
+	std::error_code error;
+	std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+	hits++;
+	Entry entry;
+	entry.payload = bytes + RECORD_CACHE_HEADER_SIZE + key_size;
+	entry.payload_size = payload_size;
+	entry.mapping = std::move(mapping);
+	return entry;
+}
+
+int Decoder::RecordCache::store(const uint8_t *compressed, size_t size, const uint8_t *payload, size_t payload_size){
+	std::string path = entryPath(compressed, size);
+	std::error_code error;
+	if(std::filesystem::exists(path, error)) return 0;
+
+	// Write under a name unique to this writer, then rename into place (atomic, so readers never see a partial entry)
+	std::string temp_path = path + ".tmp" + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()))
+		+ "-" + std::to_string(temp_counter++) + "-" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count());
+	uint64_t key_size = size;
+	uint64_t stored_payload_size = payload_size;
+	std::ofstream out(temp_path, std::ios::binary);
+	out.write(RECORD_CACHE_MAGIC, sizeof(RECORD_CACHE_MAGIC));
+	out.write(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+	out.write(reinterpret_cast<const char*>(&stored_payload_size), sizeof(stored_payload_size));
+	out.write(reinterpret_cast<const char*>(compressed), size);
+	out.write(reinterpret_cast<const char*>(payload), payload_size);
+	out.close();
+	if(!out.good()){
+		std::filesystem::remove(temp_path, error);
+		return -1;
+	}
+	std::filesystem::rename(temp_path, path, error);
+	if(error){
+		std::filesystem::remove(temp_path, error);
+		return -1;
+	}
+
+	stores++;
+	if((approx_bytes += RECORD_CACHE_HEADER_SIZE + size + payload_size) > max_bytes) evict();
+	return 0;
+}
+
+void Decoder::RecordCache::evict(){
+	// One evicting thread at a time, others carry on (the directory is rescanned as other processes may share it)
+	std::unique_lock<std::mutex> guard(evict_lock, std::try_to_lock);
+	if(!guard.owns_lock()) return;
+
+	typedef struct {
+		std::filesystem::path path;
+		std::filesystem::file_time_type used;
+		uint64_t size;
+	} cache_entry;
+
+	std::error_code error;
+	std::vector<cache_entry> entries;
+	uint64_t total = 0;
+	std::filesystem::file_time_type stale = std::filesystem::file_time_type::clock::now() - std::chrono::hours(1);
+	for(const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator(directory, error)){
+		std::filesystem::file_time_type used = entry.last_write_time(error);
+		if(error) continue;
+
+		// Temporary files of writers that died mid-write
+		if(entry.path().extension() != ".rec"){
+			if(entry.path().filename().string().find(".rec.tmp") != std::string::npos && used < stale)
+				std::filesystem::remove(entry.path(), error);
+			continue;
+		}
+
+		uint64_t size = entry.file_size(error);
+		if(error) continue;
+		entries.push_back({entry.path(), used, size});
+		total += size;
+	}
+
+	// Least recently used first (removing an entry another reader has mapped is safe, its mapping stays valid)
+	std::sort(entries.begin(), entries.end(), [](const cache_entry &a, const cache_entry &b){ return a.used < b.used; });
+	for(const cache_entry &entry : entries){
+		if(total <= max_bytes) break;
+		if(std::filesystem::remove(entry.path, error)) evictions++;
+		total -= entry.size;
+	}
+	approx_bytes = total;
+}
+
+Decoder::RecordCache::Stats Decoder::RecordCache::stats() const{
+	return Stats{hits.load(), misses.load(), stores.load(), evictions.load()};
+}
@@ -0,0 +1,135 @@
+/**
+ * @file record_cache.hpp
+ * @brief Header file for an on-disk cache of decompressed LDM records shared across archive decodes
+ * @author Owen Capell
+*/
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+#include "mapped_file.hpp"
+
+/**
+ * @namespace Decoder
+ * @brief Encapsulate decoding functions
+*/
+namespace Decoder
+{
+	/**
+	 * @class RecordCache
+	 * @brief A directory of decompressed LDM record payloads, keyed by a hash of the compressed record bytes, so repeat decodes map payloads instead of decompressing.
+	 * Each entry also holds the full compressed record, which a hit must match, so hash collisions and damaged entries are only misses.
+	 * Entries are written to a temporary file and renamed into place, so concurrent writers (threads or processes) never expose partial entries.
+	 * Entries are evicted least recently used first (by modification time, refreshed on every hit) once the directory grows past its size bound
+	*/
+	class RecordCache{
+	public:
+		/**
+		 * @struct Stats
+		 * @brief Counters describing how well the cache is used
+		 * @member hits
+		 * Member 'hits' is the number of records served from the cache
+		 * @member misses
+		 * Member 'misses' is the number of records not found in the cache
+		 * @member stores
+		 * Member 'stores' is the number of records written to the cache
+		 * @member evictions
+		 * Member 'evictions' is the number of entries removed to keep the cache within its size bound
+		*/
+		struct Stats{
+			uint64_t hits;
+			uint64_t misses;
+			uint64_t stores;
+			uint64_t evictions;
+		};
+
+		/**
+		 * @struct Entry
+		 * @brief A mapped cache entry
+		 * @member mapping
+		 * Member 'mapping' is the mapping of the whole entry, which the payload stays valid with (nullptr when not cached)
+		 * @member payload
+		 * Member 'payload' is a pointer to the decompressed record within the mapping
+		 * @member payload_size
+		 * Member 'payload_size' is the number of decompressed bytes
+		*/
+		struct Entry{
+			std::shared_ptr<MappedFile> mapping;
+			const uint8_t *payload = nullptr;
+			size_t payload_size = 0;
+		};
+
+	private:
+		std::string directory;
+		uint64_t max_bytes;
+		std::mutex evict_lock;
+		std::atomic<uint64_t> approx_bytes;
+		std::atomic<uint64_t> temp_counter;
+		std::atomic<uint64_t> hits;
+		std::atomic<uint64_t> misses;
+		std::atomic<uint64_t> stores;
+		std::atomic<uint64_t> evictions;
+
+		/**
+		 * @brief Gives the path of the entry for a compressed record
+		 * @param compressed Pointer to the compressed record bytes
+		 * @param size Number of compressed bytes
+		 * @return Path of the entry
+		*/
+		std::string entryPath(const uint8_t *compressed, size_t size) const;
+
+		/**
+		 * @brief Removes least recently used entries until the directory fits within the size bound
+		*/
+		void evict();
+
+	public:
+		/**
+		 * @brief Constructor accepting the cache directory (created if missing) and its size bound
+		 * @param directory Directory holding the cache entries
+		 * @param max_bytes Total size of entries to keep
+		*/
+		RecordCache(const std::string &directory, uint64_t max_bytes);
+
+		RecordCache(const RecordCache&) = delete;
+		RecordCache& operator=(const RecordCache&) = delete;
+
+		/**
+		 * @brief Computes the 64-bit hash entries are keyed by (fast, not cryptographic)
+		 * @param bytes Pointer to the bytes to hash
+		 * @param size Number of bytes
+		 * @return Hash of the bytes
+		*/
+		static uint64_t hash(const uint8_t *bytes, size_t size);
+
+		/**
+		 * @brief Maps the cached payload of a compressed record, marking the entry as recently used
+		 * @param compressed Pointer to the compressed record bytes
+		 * @param size Number of compressed bytes
+		 * @return Mapped entry, with a nullptr mapping when not cached (or the entry holds another record, or is damaged)
+		*/
+		Entry lookup(const uint8_t *compressed, size_t size);
+
+		/**
+		 * @brief Stores the decompressed payload of a compressed record, evicting older entries if the cache grows past its bound
+		 * @param compressed Pointer to the compressed record bytes
+		 * @param size Number of compressed bytes
+		 * @param payload Pointer to the decompressed bytes
+		 * @param payload_size Number of decompressed bytes
+		 * @return 0 on success, -1 if the entry could not be written (the cache is only an optimization, so callers carry on)
+		*/
+		int store(const uint8_t *compressed, size_t size, const uint8_t *payload, size_t payload_size);
+
+		/**
+		 * @brief Reports the hit, miss, store and eviction counts since construction
+		 * @return Snapshot of the counters
+		*/
+		Stats stats() const;
+	};
+}
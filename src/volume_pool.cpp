@@ -0,0 +1,77 @@
+#include <iostream>
+#include <vector>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <mutex>
+
+#include "volume_pool.hpp"
+
+
+Decoder::VolumePool::VolumePool(const ArchiveOptions &options, unsigned int threads, std::function<void(const std::string&, int, archive_file&)> on_volume)
+	: options(options), on_volume(std::move(on_volume)), window(2*resolveThreads(threads)), jobs(resolveThreads(threads)),
+	submitted(0), delivered(0), finished(false){
+	for(unsigned int t=0; t<resolveThreads(threads); t++){
+		workers.emplace_back([this](){
+			volume_job job;
+			while(jobs.pop(job)){
+				volume_result result;
+				result.name = std::move(job.name);
+				// A throw would terminate the whole batch, so it only fails this volume
+				try{
+					result.status = Decoder::DecodeArchive(job.bytes.data(), job.bytes.size(), result.file, this->options);
+				}
+				catch(const std::exception &e){
+					std::cerr << "Error decoding " << result.name << ": " << e.what() << std::endl;
+					result.status = -1;
+				}
+				if(this->options.pool) this->options.pool->recycle(std::move(job.bytes));
+
+				std::lock_guard<std::mutex> guard(results_lock);
+				results.emplace(job.index, std::move(result));
+				result_ready.notify_all();
+			}
+		});
+	}
+}
+
+Decoder::VolumePool::~VolumePool(){
+	finish();
+}
+
+void Decoder::VolumePool::deliver(size_t limit){
+	std::unique_lock<std::mutex> guard(results_lock);
+	while(delivered < submitted){
+		if(results.count(delivered) == 0){
+			if(submitted - delivered <= limit) break;
+			result_ready.wait(guard, [this](){ return results.count(delivered) > 0; });
+		}
+		volume_result result = std::move(results[delivered]);
+		results.erase(delivered);
+		guard.unlock();
+		on_volume(result.name, result.status, result.file);
+		guard.lock();
+		delivered++;
+	}
+}
+
+void Decoder::VolumePool::submit(std::string name, std::vector<uint8_t> &&bytes){
+	deliver(window-1);
+
+	volume_job job;
+	job.index = submitted;
+	job.name = std::move(name);
+	job.bytes = std::move(bytes);
+	jobs.push(std::move(job));
+	submitted++;
+}
+
+void Decoder::VolumePool::finish(){
+	if(finished) return;
+	finished = true;
+
+	// Let the workers drain the remaining archives, then hand the rest back
+	jobs.close();
+	deliver(0);
+	for(std::thread &worker : workers) worker.join();
+}
@@ -0,0 +1,93 @@
+/**
+ * @file volume_pool.hpp
+ * @brief Header file for a pool of threads decoding whole in-memory archives, handing volumes back in submission order
+ * @author Owen Capell
+*/
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "decoder.hpp"
+#include "lvltwodef.hpp"
+#include "parallel.hpp"
+
+/**
+ * @namespace Decoder
+ * @brief Encapsulate decoding functions
+*/
+namespace Decoder
+{
+	/**
+	 * @class VolumePool
+	 * @brief Decodes submitted archive bytes with DecodeArchive on worker threads, handing each decoded volume back (in submission order)
+	 * on the submitting thread. At most twice the worker count of volumes are held at once, so submitting blocks while that many are in flight
+	*/
+	class VolumePool{
+	private:
+		typedef struct {
+			size_t index;
+			std::string name;
+			std::vector<uint8_t> bytes;
+		} volume_job;
+
+		typedef struct {
+			std::string name;
+			int status;
+			archive_file file;
+		} volume_result;
+
+		ArchiveOptions options;
+		std::function<void(const std::string&, int, archive_file&)> on_volume;
+		size_t window;
+		BoundedQueue<volume_job> jobs;
+		std::map<size_t, volume_result> results;
+		std::mutex results_lock;
+		std::condition_variable result_ready;
+		std::vector<std::thread> workers;
+		size_t submitted;
+		size_t delivered;
+		bool finished;
+
+		/**
+		 * @brief Hands back every volume that is next in order and done, waiting while more than limit are in flight
+		 * @param limit Number of volumes allowed to stay in flight
+		*/
+		void deliver(size_t limit);
+
+	public:
+		/**
+		 * @brief Constructor starting the workers
+		 * @param options Options controlling decompression of each archive (see ArchiveOptions)
+		 * @param threads Number of archives decoded concurrently (0 for one per hardware core)
+		 * @param on_volume Called with each archive's name, DecodeArchive status and decoded volume, in submission order
+		*/
+		VolumePool(const ArchiveOptions &options, unsigned int threads, std::function<void(const std::string&, int, archive_file&)> on_volume);
+
+		/**
+		 * @brief Destructor finishing (see finish) if not done already
+		*/
+		~VolumePool();
+
+		VolumePool(const VolumePool&) = delete;
+		VolumePool& operator=(const VolumePool&) = delete;
+
+		/**
+		 * @brief Queues archive bytes for decoding, first handing back finished volumes (and waiting if too many are in flight)
+		 * @param name Name handed back with the volume
+		 * @param bytes Archive bytes (given back to the buffer pool, if any, once decoded)
+		*/
+		void submit(std::string name, std::vector<uint8_t> &&bytes);
+
+		/**
+		 * @brief Waits for every submitted archive to be decoded and handed back, then stops the workers
+		*/
+		void finish();
+	};
+}
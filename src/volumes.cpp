@@ -0,0 +1,124 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+
+#include "decoder.hpp"
+#include "lvltwodef.hpp"
+#include "parallel.hpp"
+
+
+/**
+ * @brief Checks for a volume header ("AR2V00" then the "vv.eee" version and extension number) at a position
+ * @return Boolean indicator of whether a volume header starts at pos
+*/
+static bool isVolumeHeader(const uint8_t *in, uint64_t in_size, uint64_t pos){
+	if(pos > in_size || in_size-pos < VOLUME_HEADER_SIZE || std::memcmp(in+pos, "AR2V00", 6) != 0) return false;
+	const uint8_t *version = in+pos+6;
+	auto digit = [](uint8_t c){ return c >= '0' && c <= '9'; };
+	return digit(version[0]) && digit(version[1]) && version[2] == '.' && digit(version[3]) && digit(version[4]) && digit(version[5]);
+}
+
+/**
+ * @brief Finds the next volume header at or after a position
+ * @return Position of the volume header, or in_size if there is none
+*/
+static uint64_t findVolumeHeader(const uint8_t *in, uint64_t in_size, uint64_t pos){
+	while(pos < in_size){
+		const uint8_t *found = static_cast<const uint8_t*>(std::memchr(in+pos, 'A', in_size-pos));
+		if(found == nullptr) break;
+		pos = found-in;
+		if(isVolumeHeader(in, in_size, pos)) return pos;
+		pos++;
+	}
+	return in_size;
+}
+
+/**
+ * @brief Follows the LDM record control words of the volume whose header is at a position
+ * @return Position just past the volume's last record (or in_size if the input ends first), 0 if the volume is not made of bzip2 records
+*/
+static uint64_t walkVolume(const uint8_t *in, uint64_t in_size, uint64_t pos){
+	pos += VOLUME_HEADER_SIZE;
+	while(pos+4 <= in_size){
+		int32_t control_word = static_cast<int32_t>(
+			(static_cast<uint32_t>(in[pos]) << 24) |
+			(static_cast<uint32_t>(in[pos+1]) << 16) |
+			(static_cast<uint32_t>(in[pos+2]) << 8) |
+			static_cast<uint32_t>(in[pos+3])
+		);
+		uint64_t size = static_cast<uint64_t>(std::abs(static_cast<int64_t>(control_word)));
+		uint64_t start = pos+4;
+		if(size < 4 || size > in_size-start || std::memcmp(in+start, "BZh", 3) != 0) return 0;
+
+		pos = start+size;
+		// Negative size marks the last record of the volume
+		if(control_word < 0) return pos;
+	}
+	return in_size;
+}
+
+int Decoder::SplitVolumes(const uint8_t *bytes, size_t size, std::vector<volume_span> &spans){
+	spans.clear();
+	if(!isVolumeHeader(bytes, size, 0)){
+		std::cerr << "Stream does not start with a volume header." << std::endl;
+		return -1;
+	}
+
+	uint64_t pos = 0;
+	while(pos < size){
+		// Compressed volumes end after their last record, anything else (decompressed volumes, damaged or unterminated
+		// records) runs up to the next volume header
+		uint64_t end = walkVolume(bytes, size, pos);
+		if(end == 0 || (end < size && !isVolumeHeader(bytes, size, end)))
+			end = findVolumeHeader(bytes, size, pos+VOLUME_HEADER_SIZE);
+		spans.push_back({pos, end-pos});
+		pos = end;
+	}
+
+	return 0;
+}
+
+int Decoder::DecodeVolumes(const uint8_t *bytes, size_t size, std::vector<archive_file> &files, std::vector<int> &statuses,
+	const ArchiveOptions &options, unsigned int threads){
+	if(options.gzip && size >= GZIP_MIN_SIZE && bytes[0] == 0x1f && bytes[1] == 0x8b){
+		std::vector<uint8_t> post_gzip;
+		if(ArchiveFile::decompressGzip(bytes, size, post_gzip, options.pool.get()) < 0){
+			std::cerr << "Unable to decompress volume stream." << std::endl;
+			return -1;
+		}
+		return Decoder::DecodeVolumes(post_gzip.data(), post_gzip.size(), files, statuses, options, threads);
+	}
+
+	std::vector<volume_span> spans;
+	if(Decoder::SplitVolumes(bytes, size, spans) < 0) return -1;
+
+	// Volumes are independent, so each is decoded straight out of the stream on its own thread
+	files.clear();
+	files.resize(spans.size());
+	statuses.assign(spans.size(), 0);
+	parallelFor(spans.size(), threads, [&](size_t i){
+		statuses[i] = Decoder::DecodeArchive(bytes+spans[i].offset, spans[i].size, files[i], options);
+	});
+
+	int status = 0;
+	for(size_t i=0; i<statuses.size(); i++){
+		if(statuses[i] == 0) continue;
+		std::cerr << "Volume #" << i << " of stream failed to decode (status " << statuses[i] << ")." << std::endl;
+		status = -2;
+	}
+	return status;
+}
+
+int Decoder::DecodeVolumes(const std::string &file_name, std::vector<archive_file> &files, std::vector<int> &statuses,
+	const ArchiveOptions &options, unsigned int threads){
+	std::vector<uint8_t> post_gzip;
+	if(ArchiveFile::decompressGzip(file_name, post_gzip, options.gzip, options.pool.get()) < 0){
+		std::cerr << "Unable to read volume stream." << std::endl;
+		return -1;
+	}
+	int status = Decoder::DecodeVolumes(post_gzip.data(), post_gzip.size(), files, statuses, options, threads);
+	if(options.pool) options.pool->recycle(std::move(post_gzip));
+	return status;
+}
@@ -3,9 +3,21 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include <filesystem>
+#include <sstream>
+#include <chrono>
+#include <map>
+
+#include <zlib.h>
 
 #include "decoder.hpp"
 #include "lvltwodef.hpp"
+#include "backend.hpp"
+#include "batch_loader.hpp"
+#include "radial_reader.hpp"
 
 /* Utility Functions */
 std::vector<uint8_t> readBinaryFile(const std::string& path) {
@@ -24,6 +36,25 @@ std::vector<uint8_t> readBinaryFile(const std::string& path) {
 
     return buffer;
 }
+
+// Appends a ustar member (header block plus data padded to whole blocks) to a tar bundle
+void appendTarMember(std::vector<uint8_t> &tar, const std::string &name, char type, const std::vector<uint8_t> &data) {
+    std::vector<uint8_t> header(512, 0);
+    std::memcpy(header.data(), name.c_str(), std::min<size_t>(name.size(), 100));
+    std::snprintf(reinterpret_cast<char*>(&header[100]), 8, "%07o", 0644);
+    std::snprintf(reinterpret_cast<char*>(&header[124]), 12, "%011lo", static_cast<unsigned long>(data.size()));
+    header[156] = type;
+    std::memcpy(&header[257], "ustar", 6);
+    std::memcpy(&header[263], "00", 2);
+    std::memset(&header[148], ' ', 8);
+    unsigned long sum = 0;
+    for (uint8_t byte : header) sum += byte;
+    std::snprintf(reinterpret_cast<char*>(&header[148]), 8, "%06lo", sum);
+
+    tar.insert(tar.end(), header.begin(), header.end());
+    tar.insert(tar.end(), data.begin(), data.end());
+    tar.resize(tar.size() + (512 - data.size() % 512) % 512, 0);
+}
 /* End Utility Functions */
 
 // Tests reversing endianness of one-byte data types
@@ -66,6 +97,13 @@ TEST(ReverseEndianTest, HandlesFourByte){
 	EXPECT_EQ(0x00000000, reverseFive) << "Expected: " << std::hex << 0x00000000 << " but Got: " << reverseFive << std::dec;
 }
 
+// Tests reversing endianness of signed data types and at compile time
+TEST(ReverseEndianTest, HandlesSignedAndConstexpr){
+	static_assert(Decoder::reverseEndian<uint32_t>(0x1234ABCD) == 0xCDAB3412, "reverseEndian is constexpr");
+	EXPECT_EQ(static_cast<int16_t>(0xF0FF), Decoder::reverseEndian<int16_t>(static_cast<int16_t>(0xFFF0)));
+	EXPECT_EQ(-2, Decoder::reverseEndian<int32_t>(Decoder::reverseEndian<int32_t>(-2)));
+}
+
 // Tests reversing endianness of eight-byte data types
 TEST(ReverseEndianTest, HandlesEightByte){
 	uint64_t reverseOne = Decoder::reverseEndian<uint64_t>(0x123456789ABCDEFF);
@@ -108,4 +146,1046 @@ TEST(ParseFile, ParseFileHeader){
 	EXPECT_EQ(6, file.header->version) << "Expected: 6 but Got: " << file.header->version;
 	EXPECT_EQ(50, file.header->extension_num) << "Expected: 50 but Got: " << file.header->extension_num;
 	EXPECT_EQ("KDIX", file.header->icao) << "Expected: \"KDIX\" but Got: \"" << file.header->icao << "\"";
-}
\ No newline at end of file
+}
+
+// Tests that decompressing LDM records on a thread pool matches serial decompression
+TEST(Bzip2Decompress, ParallelMatchesSerial){
+	Decoder::ArchiveFile serial("archives/KDIX20240517_025206_V06");
+	Decoder::ArchiveOptions options;
+	options.threads = 4;
+	Decoder::ArchiveFile parallel("archives/KDIX20240517_025206_V06", options);
+	ASSERT_TRUE(parallel.isInitialized());
+	EXPECT_EQ(serial.num_blocks(), parallel.num_blocks());
+	EXPECT_EQ(serial.getAll(), parallel.getAll());
+}
+
+// Tests framing LDM records by their control words
+TEST(Bzip2Decompress, WalksRecordControlWords){
+	Decoder::ArchiveFile file("archives/KDIX20240517_025206_V06");
+	ASSERT_TRUE(file.isInitialized());
+	const std::vector<ldm_record> &records = file.records();
+	ASSERT_EQ(56, records.size());
+	EXPECT_FALSE(records[0].compressed);
+	EXPECT_EQ(24, records[0].size);
+	EXPECT_TRUE(records[1].compressed);
+	EXPECT_EQ(28, records[1].offset);
+	EXPECT_EQ(55, file.num_blocks());
+}
+
+// Tests that damaged control words fail the walk but decode in recovery mode
+TEST(Bzip2Decompress, RecoversDamagedControlWord){
+	std::vector<uint8_t> archive = readBinaryFile("archives/KDIX20240517_025206_V06");
+	Decoder::ArchiveFile intact("archives/KDIX20240517_025206_V06");
+	const ldm_record &second = intact.records()[2];
+	// Corrupt the sign-preserving high byte of the second record's control word
+	archive[second.offset-4] = 0x7F;
+	std::ofstream out("DAMAGED_CONTROL_WORD", std::ios::binary);
+	out.write(reinterpret_cast<const char*>(archive.data()), archive.size());
+	out.close();
+
+	Decoder::ArchiveFile damaged("DAMAGED_CONTROL_WORD");
+	EXPECT_FALSE(damaged.isInitialized());
+
+	Decoder::ArchiveOptions options;
+	options.recover = true;
+	Decoder::ArchiveFile recovered("DAMAGED_CONTROL_WORD", options);
+	ASSERT_TRUE(recovered.isInitialized());
+	EXPECT_EQ(intact.num_blocks(), recovered.num_blocks());
+	EXPECT_EQ(intact.getAll(), recovered.getAll());
+}
+
+// Tests that a damaged control word followed by back to back bzip2 stream headers is skipped rather than scanned forever
+TEST(Bzip2Decompress, RecoversBackToBackStreamHeaders){
+	std::vector<uint8_t> archive = readBinaryFile("archives/KDIX20240517_025206_V06");
+	Decoder::ArchiveFile intact("archives/KDIX20240517_025206_V06");
+	const ldm_record &first = intact.records()[1];
+	archive.resize(first.offset + first.size);
+	const char tail[] = {0, 0, 0, 0, 'B', 'Z', 'h', '9', 'B', 'Z', 'h', '9'};
+	archive.insert(archive.end(), std::begin(tail), std::end(tail));
+
+	std::vector<ldm_record> records;
+	Decoder::ArchiveFile::scanRecords(archive.data(), archive.size(), records);
+	ASSERT_FALSE(records.empty());
+	EXPECT_EQ(archive.size(), records.back().offset + records.back().size);
+
+	Decoder::ArchiveOptions options;
+	options.recover = true;
+	Decoder::ArchiveFile recovered(archive.data(), archive.size(), options);
+	ASSERT_TRUE(recovered.isInitialized());
+	EXPECT_FALSE(recovered.badRecords().empty());
+}
+
+// Tests successfully decompressing a Gzip-compressed archive file that was itself Gzip compressed again
+TEST(GzipDecompress, DecompressesDoubleGzipFile){
+	std::vector<uint8_t> single = readBinaryFile("gz2archives/KDIX20240517_025206_V06.gz");
+	gzFile out = gzopen("gz2archives/KDIX20240517_025206_V06.gz.gz", "wb");
+	ASSERT_NE(nullptr, out);
+	gzwrite(out, single.data(), single.size());
+	gzclose(out);
+
+	Decoder::ArchiveFile file("gz2archives/KDIX20240517_025206_V06.gz.gz", true, false);
+	ASSERT_TRUE(file.isInitialized());
+	std::vector<uint8_t> compare = readBinaryFile("archives/KDIX20240517_025206_V06");
+	EXPECT_EQ(file.getAll(), compare);
+}
+
+// Tests that a corrupt ISIZE trailer cannot presize more than the compressed bytes could inflate to
+TEST(GzipDecompress, ClampsSizeHintOfCorruptTrailer){
+	const uint8_t trailer[4] = {0xff, 0xff, 0xff, 0xff};
+	EXPECT_EQ(100*GZIP_MAX_RATIO, Decoder::ArchiveFile::gzipSizeHint(trailer, 100));
+	EXPECT_EQ(GZIP_MAX_SIZE_HINT, Decoder::ArchiveFile::gzipSizeHint(trailer, 1 << 20));
+	const uint8_t small[4] = {0x10, 0x00, 0x00, 0x00};
+	EXPECT_EQ(16u, Decoder::ArchiveFile::gzipSizeHint(small, 100));
+
+	// A truncated stream still fails cleanly rather than allocating gigabytes
+	std::vector<uint8_t> gzipped = readBinaryFile("gz2archives/KDIX20240517_025206_V06.gz");
+	gzipped.resize(gzipped.size()/2);
+	std::memset(gzipped.data() + gzipped.size() - 4, 0xff, 4);
+	std::vector<uint8_t> out;
+	EXPECT_EQ(-1, Decoder::ArchiveFile::decompressGzip(gzipped.data(), gzipped.size(), out));
+}
+
+// Tests reading an already-decompressed archive file in place from memory mapped pages
+TEST(MappedArchive, ReadsDecompressedArchiveInPlace){
+	Decoder::ArchiveFile decompressed("archives/KDIX20240517_025206_V06");
+	decompressed.dump_to_file("DECOMP_KDIX20240517_025206_V06");
+
+	Decoder::ArchiveOptions options;
+	options.mmap = true;
+	Decoder::ArchiveFile mapped("DECOMP_KDIX20240517_025206_V06", options);
+	ASSERT_TRUE(mapped.isInitialized());
+	EXPECT_TRUE(mapped.isMapped());
+	EXPECT_EQ(0, mapped.num_blocks());
+	EXPECT_EQ(decompressed.getAll(), mapped.getAll());
+
+	// Compressed archives are decompressed from the mapped pages instead
+	Decoder::ArchiveFile compressed("archives/KDIX20240517_025206_V06", options);
+	ASSERT_TRUE(compressed.isInitialized());
+	EXPECT_FALSE(compressed.isMapped());
+	EXPECT_EQ(decompressed.getAll(), compressed.getAll());
+}
+
+// Tests decompressing Gzip, bzip2 record, and raw archives held in memory
+TEST(MemoryArchive, DetectsCompressionFromBytes){
+	std::vector<uint8_t> compare = readBinaryFile("archives/KDIX20240517_025206_V06");
+	Decoder::ArchiveFile expected("archives/KDIX20240517_025206_V06");
+
+	std::vector<uint8_t> gzipped = readBinaryFile("gz2archives/KDIX20240517_025206_V06.gz");
+	Decoder::ArchiveFile gzip(gzipped.data(), gzipped.size());
+	ASSERT_TRUE(gzip.isInitialized());
+	EXPECT_EQ(expected.getAll(), gzip.getAll());
+
+	Decoder::ArchiveFile bzip(compare.data(), compare.size());
+	ASSERT_TRUE(bzip.isInitialized());
+	EXPECT_EQ(55, bzip.num_blocks());
+	EXPECT_EQ(expected.getAll(), bzip.getAll());
+
+	std::vector<uint8_t> decompressed = expected.getAll();
+	Decoder::ArchiveFile raw(decompressed.data(), decompressed.size());
+	ASSERT_TRUE(raw.isInitialized());
+	EXPECT_EQ(0, raw.num_blocks());
+	EXPECT_EQ(decompressed, raw.getAll());
+}
+
+// Tests decoding an archive held in memory matches decoding it from a file
+TEST(MemoryArchive, DecodesArchiveFromBytes){
+	archive_file from_file, from_memory;
+	std::vector<uint8_t> bytes = readBinaryFile("archives/KDIX20240517_025206_V06");
+	int file_status = Decoder::DecodeArchive("archives/KDIX20240517_025206_V06", false, from_file);
+	int memory_status = Decoder::DecodeArchive(bytes.data(), bytes.size(), from_memory, Decoder::ArchiveOptions{});
+	EXPECT_EQ(file_status, memory_status);
+	EXPECT_EQ("KDIX", from_memory.header->icao);
+	EXPECT_EQ(from_file.header->date, from_memory.header->date);
+	EXPECT_EQ(from_file.header->time, from_memory.header->time);
+	for(size_t i=0; i<from_file.scan_elevations.size(); i++){
+		if(from_file.scan_elevations[i] == nullptr){
+			EXPECT_EQ(nullptr, from_memory.scan_elevations[i]);
+			continue;
+		}
+		ASSERT_NE(nullptr, from_memory.scan_elevations[i]);
+		EXPECT_EQ(from_file.scan_elevations[i]->radials.size(), from_memory.scan_elevations[i]->radials.size());
+	}
+}
+
+// Tests decoding a volume delivered as real-time chunks, publishing elevations as they complete
+TEST(ChunkDecode, PublishesElevationsAsChunksArrive){
+	archive_file whole;
+	ASSERT_EQ(0, Decoder::DecodeArchive("archives/KDIX20240517_025206_V06", false, whole));
+
+	// Split the archive like the real-time feed: header plus metadata record, then one LDM record per chunk
+	std::vector<uint8_t> bytes = readBinaryFile("archives/KDIX20240517_025206_V06");
+	Decoder::ArchiveFile framed("archives/KDIX20240517_025206_V06");
+	const std::vector<ldm_record> &records = framed.records();
+	std::vector<std::pair<uint64_t, uint64_t>> chunks;
+	chunks.push_back({0, records[1].offset+records[1].size});
+	for(size_t i=2; i<records.size(); i++){
+		if(records[i].compressed) chunks.push_back({records[i].offset-4, records[i].offset+records[i].size});
+	}
+
+	archive_file streamed;
+	std::vector<uint8_t> order;
+	size_t first_publish_chunk = 0;
+	size_t chunk_num = 0;
+	Decoder::ChunkDecoder decoder(streamed, [&](const std::shared_ptr<elevation_head> &elevation){
+		if(order.empty()) first_publish_chunk = chunk_num;
+		order.push_back(elevation->elevation_num);
+	});
+	for(; chunk_num<chunks.size(); chunk_num++){
+		ASSERT_EQ(0, decoder.push(bytes.data()+chunks[chunk_num].first, chunks[chunk_num].second-chunks[chunk_num].first));
+	}
+
+	EXPECT_TRUE(decoder.complete());
+	EXPECT_EQ("KDIX", streamed.header->icao);
+	EXPECT_EQ(12, order.size());
+	EXPECT_LT(first_publish_chunk, chunks.size()-1);
+	for(size_t i=0; i<whole.scan_elevations.size(); i++){
+		if(whole.scan_elevations[i] == nullptr) continue;
+		ASSERT_NE(nullptr, streamed.scan_elevations[i]);
+		EXPECT_EQ(whole.scan_elevations[i]->radials.size(), streamed.scan_elevations[i]->radials.size());
+	}
+}
+
+// Tests that pipelining decompression with parsing decodes the same volume
+TEST(PipelinedDecode, MatchesTwoPhaseDecode){
+	archive_file whole, pipelined;
+	ASSERT_EQ(0, Decoder::DecodeArchive("archives/KDIX20240517_025206_V06", false, whole));
+
+	Decoder::ArchiveOptions options;
+	options.pipeline_depth = 2;
+	ASSERT_EQ(0, Decoder::DecodeArchive("archives/KDIX20240517_025206_V06", false, pipelined, options));
+	EXPECT_EQ(whole.header->icao, pipelined.header->icao);
+	for(size_t i=0; i<whole.scan_elevations.size(); i++){
+		if(whole.scan_elevations[i] == nullptr){
+			EXPECT_EQ(nullptr, pipelined.scan_elevations[i]);
+			continue;
+		}
+		ASSERT_NE(nullptr, pipelined.scan_elevations[i]);
+		ASSERT_EQ(whole.scan_elevations[i]->radials.size(), pipelined.scan_elevations[i]->radials.size());
+		EXPECT_EQ(whole.scan_elevations[i]->radials.back()->ref->data, pipelined.scan_elevations[i]->radials.back()->ref->data);
+	}
+}
+
+// Tests that a volume header the parser throws on fails the pipelined decode instead of terminating
+TEST(PipelinedDecode, FailsOnMalformedVolumeHeader){
+	std::vector<uint8_t> bytes = readBinaryFile("archives/KDIX20240517_025206_V06");
+	bytes[6] = 'x';
+	bytes[7] = 'x';
+	archive_file file;
+	Decoder::ArchiveOptions options;
+	options.pipeline_depth = 2;
+	EXPECT_LT(Decoder::DecodePipelined(bytes.data(), bytes.size(), file, options), 0);
+}
+
+// Tests reading across the boundary between two decompressed LDM record segments
+TEST(SegmentedArchive, ReadsAcrossRecordBoundary){
+	Decoder::ArchiveFile file("archives/KDIX20240517_025206_V06");
+	std::vector<uint8_t> all = file.getAll();
+
+	// Metadata record is the first decompressed segment, right after the volume header
+	uint64_t boundary = VOLUME_HEADER_SIZE + METADATA_RECORD_SIZE;
+	ASSERT_TRUE(file.seek(boundary-5));
+	uint8_t spanning[10];
+	ASSERT_EQ(10, file.read(spanning, 10));
+	EXPECT_TRUE(std::equal(spanning, spanning+10, all.begin()+boundary-5));
+
+	// Seeking backwards into an earlier segment
+	ASSERT_TRUE(file.seek(2));
+	uint8_t header[4];
+	ASSERT_EQ(4, file.read(header, 4));
+	EXPECT_TRUE(std::equal(header, header+4, all.begin()+2));
+	EXPECT_EQ(6, file.position());
+}
+
+// Tests that a buffer pool shared across archives reuses decompression buffers
+TEST(BufferPool, ReusesBuffersAcrossArchives){
+	Decoder::ArchiveOptions options;
+	options.pool = std::make_shared<Decoder::BufferPool>(64, 1);
+
+	std::vector<uint8_t> first;
+	{
+		Decoder::ArchiveFile file("archives/KDIX20240517_025206_V06", options);
+		ASSERT_TRUE(file.isInitialized());
+		first = file.getAll();
+	}
+	Decoder::BufferPool::Stats cold = options.pool->stats();
+	EXPECT_GT(cold.misses, 0);
+	EXPECT_GT(cold.returns, 0);
+
+	Decoder::ArchiveFile file("archives/KDIX20240517_025206_V06", options);
+	ASSERT_TRUE(file.isInitialized());
+	EXPECT_EQ(first, file.getAll());
+	Decoder::BufferPool::Stats warm = options.pool->stats();
+	EXPECT_GT(warm.hits, cold.hits);
+	EXPECT_EQ(cold.misses, warm.misses);
+}
+
+// Tests that damaged bzip2 records fail fast, and are skipped and reported in recovery mode
+TEST(Bzip2Decompress, SkipsDamagedRecords){
+	std::vector<uint8_t> archive = readBinaryFile("archives/KDIX20240517_025206_V06");
+	Decoder::ArchiveFile intact("archives/KDIX20240517_025206_V06");
+	const ldm_record &damaged_record = intact.records()[10];
+
+	// A truncated record must be rejected rather than waiting on more input
+	std::vector<uint8_t> out;
+	EXPECT_EQ(-1, Decoder::ArchiveFile::decompressBzip2(&archive[damaged_record.offset], damaged_record.size/2, out));
+
+	// Scramble the middle of one record's compressed stream
+	for(uint64_t i=damaged_record.size/2; i<damaged_record.size/2+64; i++) archive[damaged_record.offset+i] ^= 0xA5;
+	EXPECT_EQ(-1, Decoder::ArchiveFile::decompressBzip2(&archive[damaged_record.offset], damaged_record.size, out));
+
+	Decoder::ArchiveFile strict(archive.data(), archive.size(), Decoder::ArchiveOptions());
+	EXPECT_FALSE(strict.isInitialized());
+
+	for(unsigned int threads : {1u, 4u}){
+		Decoder::ArchiveOptions options;
+		options.recover = true;
+		options.threads = threads;
+		archive_file file;
+		ASSERT_EQ(0, Decoder::DecodeArchive(archive.data(), archive.size(), file, options));
+		EXPECT_TRUE(file.partial);
+		EXPECT_EQ(std::vector<size_t>{10}, file.bad_records);
+		ASSERT_NE(nullptr, file.scan_elevations[1]);
+	}
+
+	Decoder::ArchiveOptions options;
+	options.recover = true;
+	options.pipeline_depth = 2;
+	archive_file file;
+	ASSERT_EQ(0, Decoder::DecodeArchive(archive.data(), archive.size(), file, options));
+	EXPECT_EQ(std::vector<size_t>{10}, file.bad_records);
+}
+
+// Tests probing archives for their identifying information without a full decode
+TEST(ProbeArchive, ReadsSummaryFromFirstRecord){
+	archive_file decoded;
+	ASSERT_EQ(0, Decoder::DecodeArchive("archives/KDIX20240517_025206_V06", false, decoded));
+
+	Decoder::ArchiveFile decompressed("archives/KDIX20240517_025206_V06");
+	decompressed.dump_to_file("PROBE_KDIX20240517_025206_V06");
+	std::vector<uint8_t> gzipped = readBinaryFile("gz2archives/KDIX20240517_025206_V06.gz");
+
+	std::vector<archive_summary> summaries(4);
+	EXPECT_EQ(0, Decoder::ProbeArchive("archives/KDIX20240517_025206_V06", summaries[0]));
+	EXPECT_EQ(0, Decoder::ProbeArchive("gz2archives/KDIX20240517_025206_V06.gz", summaries[1]));
+	EXPECT_EQ(0, Decoder::ProbeArchive("PROBE_KDIX20240517_025206_V06", summaries[2]));
+	EXPECT_EQ(0, Decoder::ProbeArchive(gzipped.data(), gzipped.size(), summaries[3]));
+
+	for(const archive_summary &summary : summaries){
+		EXPECT_EQ(decoded.header->icao, summary.icao);
+		EXPECT_EQ(decoded.header->version, summary.version);
+		EXPECT_EQ(decoded.header->date, summary.date);
+		EXPECT_EQ(decoded.header->time, summary.time);
+		EXPECT_EQ(summaries[0].vcp, summary.vcp);
+	}
+	EXPECT_EQ(215, summaries[0].vcp);
+
+	archive_summary summary;
+	EXPECT_EQ(-1, Decoder::ProbeArchive(gzipped.data(), 100, summary));
+}
+
+// Tests decoding every archive in a tar bundle concurrently, straight from the bundle, handed back in order
+TEST(BundleDecode, DecodesMembersInOrder){
+	std::vector<uint8_t> raw = readBinaryFile("archives/KDIX20240517_025206_V06");
+	std::vector<uint8_t> gzipped = readBinaryFile("gz2archives/KDIX20240517_025206_V06.gz");
+	std::string readme = "not an archive";
+
+	std::vector<uint8_t> tar;
+	appendTarMember(tar, "bundle/", '5', {});
+	appendTarMember(tar, "bundle/KDIX20240517_025206_V06", '0', raw);
+	appendTarMember(tar, "bundle/README", '0', std::vector<uint8_t>(readme.begin(), readme.end()));
+	size_t gzipped_start = tar.size();
+	appendTarMember(tar, "bundle/KDIX20240517_025206_V06.gz", '0', gzipped);
+	appendTarMember(tar, "bundle/KDIX20240517_025206_V06_2", '0', raw);
+	tar.resize(tar.size() + 1024, 0);
+	std::ofstream out("BUNDLE.tar", std::ios::binary);
+	out.write(reinterpret_cast<const char*>(tar.data()), tar.size());
+	out.close();
+
+	archive_file expected;
+	ASSERT_EQ(0, Decoder::DecodeArchive(raw.data(), raw.size(), expected, Decoder::ArchiveOptions()));
+
+	std::vector<std::string> names;
+	std::vector<int> statuses;
+	ASSERT_EQ(0, Decoder::DecodeBundle("BUNDLE.tar", Decoder::ArchiveOptions(), 3,
+		[&](const std::string &name, int status, archive_file &file){
+			names.push_back(name);
+			statuses.push_back(status);
+			if(status < 0) return;
+			EXPECT_EQ(expected.header->icao, file.header->icao);
+			for(size_t i=0; i<expected.scan_elevations.size(); i++){
+				if(!expected.scan_elevations[i]) continue;
+				ASSERT_NE(nullptr, file.scan_elevations[i]);
+				EXPECT_EQ(expected.scan_elevations[i]->radials.size(), file.scan_elevations[i]->radials.size());
+			}
+		}));
+
+	std::vector<std::string> expected_names = {"bundle/KDIX20240517_025206_V06", "bundle/README",
+		"bundle/KDIX20240517_025206_V06.gz", "bundle/KDIX20240517_025206_V06_2"};
+	EXPECT_EQ(expected_names, names);
+	EXPECT_EQ((std::vector<int>{0, -1, 0, 0}), statuses);
+
+	// A bundle cut off mid-member still hands back the members before the damage
+	tar.resize(gzipped_start + 512 + gzipped.size()/2);
+	out.open("TRUNCATED_BUNDLE.tar", std::ios::binary);
+	out.write(reinterpret_cast<const char*>(tar.data()), tar.size());
+	out.close();
+	names.clear();
+	EXPECT_EQ(-1, Decoder::DecodeBundle("TRUNCATED_BUNDLE.tar", Decoder::ArchiveOptions(), 2,
+		[&](const std::string &name, int, archive_file&){ names.push_back(name); }));
+	EXPECT_EQ((std::vector<std::string>{"bundle/KDIX20240517_025206_V06", "bundle/README"}), names);
+
+	// Older writers pad numeric fields with leading spaces
+	std::vector<uint8_t> padded;
+	appendTarMember(padded, "KDIX20240517_025206_V06", '0', raw);
+	std::snprintf(reinterpret_cast<char*>(&padded[124]), 12, "%11lo", static_cast<unsigned long>(raw.size()));
+	std::memset(&padded[148], ' ', 8);
+	unsigned long sum = 0;
+	for(size_t i=0; i<512; i++) sum += padded[i];
+	std::snprintf(reinterpret_cast<char*>(&padded[148]), 8, "%6lo", sum);
+	padded.resize(padded.size() + 1024, 0);
+	out.open("PADDED_BUNDLE.tar", std::ios::binary);
+	out.write(reinterpret_cast<const char*>(padded.data()), padded.size());
+	out.close();
+	statuses.clear();
+	EXPECT_EQ(0, Decoder::DecodeBundle("PADDED_BUNDLE.tar", Decoder::ArchiveOptions(), 1,
+		[&](const std::string&, int status, archive_file&){ statuses.push_back(status); }));
+	EXPECT_EQ((std::vector<int>{0}), statuses);
+}
+
+// Tests decompressing an archive wrapped whole in bzip2 block by block on a thread pool
+TEST(Bzip2Decompress, SplitsWholeFileStreamIntoBlocks){
+	std::vector<uint8_t> compressed = readBinaryFile("bzip2archives/KDIX20240517_025206_V06.bz2");
+	std::vector<uint8_t> compare = readBinaryFile("archives/KDIX20240517_025206_V06");
+
+	std::vector<uint8_t> out;
+	ASSERT_EQ(0, Decoder::ArchiveFile::decompressBzip2Stream(compressed.data(), compressed.size(), out, 4));
+	EXPECT_EQ(compare, out);
+
+	// Concatenated streams decompress back to back
+	std::vector<uint8_t> twice(compressed);
+	twice.insert(twice.end(), compressed.begin(), compressed.end());
+	ASSERT_EQ(0, Decoder::ArchiveFile::decompressBzip2Stream(twice.data(), twice.size(), out, 0));
+	ASSERT_EQ(2*compare.size(), out.size());
+	EXPECT_TRUE(std::equal(compare.begin(), compare.end(), out.begin() + compare.size()));
+
+	// Unwrapped, then framed and decompressed like any other archive
+	Decoder::ArchiveFile intact("archives/KDIX20240517_025206_V06");
+	Decoder::ArchiveOptions options;
+	options.threads = 4;
+	Decoder::ArchiveFile wrapped("bzip2archives/KDIX20240517_025206_V06.bz2", options);
+	ASSERT_TRUE(wrapped.isInitialized());
+	EXPECT_EQ(intact.num_blocks(), wrapped.num_blocks());
+	EXPECT_EQ(intact.getAll(), wrapped.getAll());
+}
+
+// Fails every stream, so whole-file streams cannot be split into blocks
+class FailingBzip2 : public Decoder::Decompressor{
+public:
+	std::string name() const override { return "failing"; }
+	Decoder::Codec codec() const override { return Decoder::Codec::BZIP2; }
+	int decompress(const uint8_t *, size_t, std::vector<uint8_t> &) const override { return -1; }
+};
+
+// Tests that a whole-file stream which cannot be split into blocks still decompresses every concatenated stream serially
+TEST(Bzip2Decompress, FallsBackToSerialAcrossConcatenatedStreams){
+	std::vector<uint8_t> compressed = readBinaryFile("bzip2archives/KDIX20240517_025206_V06.bz2");
+	std::vector<uint8_t> compare = readBinaryFile("archives/KDIX20240517_025206_V06");
+	std::vector<uint8_t> twice(compressed);
+	twice.insert(twice.end(), compressed.begin(), compressed.end());
+
+	Decoder::RegisterDecompressor(std::make_shared<FailingBzip2>());
+	ASSERT_EQ(0, Decoder::SelectDecompressor(Decoder::Codec::BZIP2, "failing"));
+	std::vector<uint8_t> out;
+	int status = Decoder::ArchiveFile::decompressBzip2Stream(twice.data(), twice.size(), out, 0);
+	std::vector<uint8_t> truncated;
+	int truncated_status = Decoder::ArchiveFile::decompressBzip2Stream(twice.data(), twice.size() - 1, truncated, 0);
+	Decoder::SelectDecompressor(Decoder::Codec::BZIP2, "bzlib");
+
+	ASSERT_EQ(0, status);
+	ASSERT_EQ(2*compare.size(), out.size());
+	EXPECT_TRUE(std::equal(compare.begin(), compare.end(), out.begin()));
+	EXPECT_TRUE(std::equal(compare.begin(), compare.end(), out.begin() + compare.size()));
+	EXPECT_EQ(-1, truncated_status);
+}
+
+// Tests that every available decompression backend decodes archives identically, and the benchmark picks a correct one
+TEST(DecompressionBackend, BackendsAgreeAndBenchmarkSelects){
+	std::vector<uint8_t> compare = readBinaryFile("archives/KDIX20240517_025206_V06");
+	Decoder::ArchiveFile reference("archives/KDIX20240517_025206_V06");
+	std::vector<uint8_t> decompressed = reference.getAll();
+
+	std::vector<std::shared_ptr<Decoder::Decompressor>> gzip = Decoder::AvailableDecompressors(Decoder::Codec::GZIP);
+	ASSERT_FALSE(gzip.empty());
+	EXPECT_EQ("zlib", gzip[0]->name());
+	for(const std::shared_ptr<Decoder::Decompressor> &backend : gzip){
+		ASSERT_EQ(0, Decoder::SelectDecompressor(Decoder::Codec::GZIP, backend->name()));
+		Decoder::ArchiveFile file("gz2archives/KDIX20240517_025206_V06.gz", true, false);
+		ASSERT_TRUE(file.isInitialized()) << backend->name();
+		EXPECT_EQ(compare, file.getAll()) << backend->name();
+	}
+	EXPECT_EQ(-1, Decoder::SelectDecompressor(Decoder::Codec::GZIP, "no-such-backend"));
+
+	for(const std::shared_ptr<Decoder::Decompressor> &backend : Decoder::AvailableDecompressors(Decoder::Codec::BZIP2)){
+		ASSERT_EQ(0, Decoder::SelectDecompressor(Decoder::Codec::BZIP2, backend->name()));
+		Decoder::ArchiveFile file("archives/KDIX20240517_025206_V06");
+		EXPECT_EQ(decompressed, file.getAll()) << backend->name();
+	}
+
+	std::vector<Decoder::BackendBenchmark> results = Decoder::BenchmarkDecompressors(1 << 20, 1);
+	for(Decoder::Codec codec : {Decoder::Codec::GZIP, Decoder::Codec::BZIP2}){
+		size_t selected = 0;
+		for(const Decoder::BackendBenchmark &result : results){
+			if(result.codec != codec) continue;
+			EXPECT_TRUE(result.correct) << result.name;
+			EXPECT_GT(result.throughput, 0.0) << result.name;
+			if(result.selected){
+				selected++;
+				EXPECT_EQ(result.name, Decoder::ActiveDecompressor(codec)->name());
+			}
+		}
+		EXPECT_EQ(1, selected);
+	}
+
+	Decoder::SelectDecompressor(Decoder::Codec::GZIP, "zlib");
+	Decoder::SelectDecompressor(Decoder::Codec::BZIP2, "bzlib");
+}
+
+// Tests that a record cache serves repeat decodes from mapped payloads and stays within its size bound
+TEST(RecordCache, MapsCachedRecordsOnRepeatDecode){
+	std::filesystem::remove_all("RECORD_CACHE");
+	Decoder::ArchiveFile uncached("archives/KDIX20240517_025206_V06");
+	std::vector<uint8_t> decompressed = uncached.getAll();
+
+	Decoder::ArchiveOptions options;
+	options.cache = std::make_shared<Decoder::RecordCache>("RECORD_CACHE", uint64_t(1) << 30);
+	{
+		Decoder::ArchiveFile cold("archives/KDIX20240517_025206_V06", options);
+		EXPECT_EQ(decompressed, cold.getAll());
+	}
+	Decoder::RecordCache::Stats stats = options.cache->stats();
+	EXPECT_EQ(0, stats.hits);
+	EXPECT_EQ(uncached.num_blocks(), stats.stores);
+
+	// Parallel and pipelined decodes map the entries written above
+	options.threads = 4;
+	Decoder::ArchiveFile warm("archives/KDIX20240517_025206_V06", options);
+	EXPECT_EQ(decompressed, warm.getAll());
+	EXPECT_EQ(uncached.num_blocks(), warm.num_blocks());
+	EXPECT_EQ(uncached.num_blocks(), options.cache->stats().hits);
+
+	archive_file expected, pipelined;
+	ASSERT_EQ(0, Decoder::DecodeArchive(uncached, expected));
+	options.pipeline_depth = 4;
+	ASSERT_EQ(0, Decoder::DecodeArchive("archives/KDIX20240517_025206_V06", false, pipelined, options));
+	EXPECT_EQ(2*uncached.num_blocks(), options.cache->stats().hits);
+	for(size_t i=0; i<expected.scan_elevations.size(); i++){
+		if(!expected.scan_elevations[i]) continue;
+		ASSERT_NE(nullptr, pipelined.scan_elevations[i]);
+		EXPECT_EQ(expected.scan_elevations[i]->radials.size(), pipelined.scan_elevations[i]->radials.size());
+	}
+
+	// A bound smaller than the volume evicts down to it
+	Decoder::RecordCache small("RECORD_CACHE", decompressed.size()/4);
+	small.store(reinterpret_cast<const uint8_t*>("trigger"), 7, decompressed.data(), 1);
+	EXPECT_GT(small.stats().evictions, 0);
+	uint64_t total = 0;
+	for(const std::filesystem::directory_entry &entry : std::filesystem::directory_iterator("RECORD_CACHE")) total += entry.file_size();
+	EXPECT_LE(total, decompressed.size()/4);
+
+	// An entry holding another record (as after a hash collision) or a damaged entry is a miss, never another record's payload
+	auto entry_path = [](const std::string &key){
+		char name[64];
+		std::snprintf(name, sizeof(name), "%016llx-%llx.rec",
+			static_cast<unsigned long long>(Decoder::RecordCache::hash(reinterpret_cast<const uint8_t*>(key.data()), key.size())),
+			static_cast<unsigned long long>(key.size()));
+		return std::string("RECORD_CACHE/") + name;
+	};
+	Decoder::RecordCache verified("RECORD_CACHE", uint64_t(1) << 30);
+	const uint8_t payload[4] = {1, 2, 3, 4};
+	ASSERT_EQ(0, verified.store(reinterpret_cast<const uint8_t*>("record-a"), 8, payload, sizeof(payload)));
+	Decoder::RecordCache::Entry hit = verified.lookup(reinterpret_cast<const uint8_t*>("record-a"), 8);
+	ASSERT_NE(nullptr, hit.mapping);
+	ASSERT_EQ(sizeof(payload), hit.payload_size);
+	EXPECT_EQ(0, std::memcmp(payload, hit.payload, sizeof(payload)));
+
+	std::filesystem::copy_file(entry_path("record-a"), entry_path("record-b"), std::filesystem::copy_options::overwrite_existing);
+	EXPECT_EQ(nullptr, verified.lookup(reinterpret_cast<const uint8_t*>("record-b"), 8).mapping);
+	std::filesystem::resize_file(entry_path("record-a"), 12);
+	EXPECT_EQ(nullptr, verified.lookup(reinterpret_cast<const uint8_t*>("record-a"), 8).mapping);
+	EXPECT_FALSE(std::filesystem::exists(entry_path("record-a")));
+}
+
+// Counts the records handed to the reference bzip2 backend
+class CountingBzip2 : public Decoder::Decompressor{
+public:
+	std::shared_ptr<Decoder::Decompressor> reference = Decoder::ActiveDecompressor(Decoder::Codec::BZIP2);
+	mutable std::atomic<size_t> calls{0};
+
+	std::string name() const override { return "counting"; }
+	Decoder::Codec codec() const override { return Decoder::Codec::BZIP2; }
+	int decompress(const uint8_t *in, size_t in_size, std::vector<uint8_t> &out) const override{
+		calls++;
+		return reference->decompress(in, in_size, out);
+	}
+};
+
+// Tests decoding only the requested elevations, decompressing records only until they are complete
+TEST(LazyDecode, DecodesRequestedElevationsOnly){
+	archive_file full;
+	ASSERT_EQ(0, Decoder::DecodeArchive("archives/KDIX20240517_025206_V06", false, full));
+
+	std::shared_ptr<CountingBzip2> counting = std::make_shared<CountingBzip2>();
+	Decoder::RegisterDecompressor(counting);
+	ASSERT_EQ(0, Decoder::SelectDecompressor(Decoder::Codec::BZIP2, "counting"));
+
+	Decoder::ArchiveOptions options;
+	options.elevations = {1, 2};
+	archive_file lazy;
+	ASSERT_EQ(0, Decoder::DecodeArchive("archives/KDIX20240517_025206_V06", false, lazy, options));
+	Decoder::SelectDecompressor(Decoder::Codec::BZIP2, "bzlib");
+
+	for(size_t i=0; i<lazy.scan_elevations.size(); i++){
+		if(i == 1 || i == 2){
+			ASSERT_NE(nullptr, lazy.scan_elevations[i]);
+			EXPECT_EQ(full.scan_elevations[i]->radials.size(), lazy.scan_elevations[i]->radials.size());
+			EXPECT_EQ(full.scan_elevations[i]->radials.back()->ref->data, lazy.scan_elevations[i]->radials.back()->ref->data);
+		}
+		else EXPECT_EQ(nullptr, lazy.scan_elevations[i]);
+	}
+
+	// 55 records hold the whole volume, the two lowest sweeps need only a handful
+	EXPECT_LT(counting->calls, 55/3);
+}
+
+// Tests loading a batch of files through io_uring (when available) and through reader threads
+TEST(BatchLoad, LoadsFilesThroughEitherReader){
+	std::vector<std::string> names = {"archives/KDIX20240517_025206_V06", "gz2archives/KDIX20240517_025206_V06.gz", "archives/missing"};
+	for(bool io_uring : {true, false}){
+		Decoder::BatchLoader loader(2, nullptr, io_uring);
+		std::vector<int> statuses(names.size(), 1);
+		std::vector<std::vector<uint8_t>> loaded(names.size());
+		EXPECT_EQ(-1, loader.load(names, [&](size_t index, int status, std::vector<uint8_t> &&bytes){
+			statuses[index] = status;
+			loaded[index] = std::move(bytes);
+		}));
+		if(!io_uring){
+			EXPECT_FALSE(loader.usedIoUring());
+		}
+
+		EXPECT_EQ(0, statuses[0]);
+		EXPECT_EQ(0, statuses[1]);
+		EXPECT_EQ(-1, statuses[2]);
+		EXPECT_EQ(readBinaryFile(names[0]), loaded[0]);
+		EXPECT_EQ(readBinaryFile(names[1]), loaded[1]);
+	}
+}
+
+// Tests decoding a batch of files with reads kept in flight, every file handed back once
+TEST(BatchLoad, DecodesEveryFile){
+	std::vector<std::string> names = {"archives/KDIX20240517_025206_V06", "gz2archives/KDIX20240517_025206_V06.gz",
+		"archives/missing", "archives/KDIX20240517_025206_V06"};
+	archive_file expected_volume;
+	ASSERT_EQ(0, Decoder::DecodeArchive(names[0], false, expected_volume));
+
+	std::vector<std::string> seen;
+	EXPECT_EQ(-1, Decoder::DecodeFiles(names, Decoder::ArchiveOptions(), 2, [&](const std::string &name, int status, archive_file &file){
+		seen.push_back(name);
+		if(name == "archives/missing"){
+			EXPECT_EQ(-1, status);
+			return;
+		}
+		ASSERT_EQ(0, status);
+		ASSERT_EQ(expected_volume.scan_elevations.size(), file.scan_elevations.size());
+		for(size_t i=0; i<file.scan_elevations.size(); i++){
+			if(expected_volume.scan_elevations[i] == nullptr) continue;
+			ASSERT_NE(nullptr, file.scan_elevations[i]);
+			EXPECT_EQ(expected_volume.scan_elevations[i]->radials.size(), file.scan_elevations[i]->radials.size());
+		}
+	}));
+
+	std::sort(seen.begin(), seen.end());
+	std::vector<std::string> expected = names;
+	std::sort(expected.begin(), expected.end());
+	EXPECT_EQ(expected, seen);
+
+	// A volume header with non-digit version fields fails only that volume
+	std::vector<uint8_t> malformed = readBinaryFile("archives/KDIX20240517_025206_V06");
+	std::memcpy(malformed.data()+6, "xx.yyy", 6);
+	std::ofstream out("MALFORMED_HEADER", std::ios::binary);
+	out.write(reinterpret_cast<const char*>(malformed.data()), malformed.size());
+	out.close();
+	std::map<std::string, int> statuses;
+	Decoder::DecodeFiles({"MALFORMED_HEADER", names[0]}, Decoder::ArchiveOptions(), 2, [&](const std::string &name, int status, archive_file&){
+		statuses[name] = status;
+	});
+	EXPECT_EQ((std::map<std::string, int>{{"MALFORMED_HEADER", -1}, {names[0], 0}}), statuses);
+}
+
+// Tests splitting concatenated volumes and decoding each like a standalone archive
+TEST(MultiVolume, SplitsConcatenatedVolumes){
+	std::vector<uint8_t> raw = readBinaryFile("archives/KDIX20240517_025206_V06");
+	Decoder::ArchiveFile archive("archives/KDIX20240517_025206_V06");
+	std::vector<uint8_t> decompressed = archive.getAll();
+	archive_file expected;
+	ASSERT_EQ(0, Decoder::DecodeArchive(raw.data(), raw.size(), expected, Decoder::ArchiveOptions()));
+
+	// Compressed, decompressed and compressed volumes back to back
+	std::vector<uint8_t> stream = raw;
+	stream.insert(stream.end(), decompressed.begin(), decompressed.end());
+	stream.insert(stream.end(), raw.begin(), raw.end());
+
+	std::vector<volume_span> spans;
+	ASSERT_EQ(0, Decoder::SplitVolumes(stream.data(), stream.size(), spans));
+	ASSERT_EQ(3u, spans.size());
+	EXPECT_EQ(0u, spans[0].offset);
+	EXPECT_EQ(raw.size(), spans[0].size);
+	EXPECT_EQ(decompressed.size(), spans[1].size);
+	EXPECT_EQ(raw.size()+decompressed.size(), spans[2].offset);
+
+	std::vector<archive_file> files;
+	std::vector<int> statuses;
+	ASSERT_EQ(0, Decoder::DecodeVolumes(stream.data(), stream.size(), files, statuses, Decoder::ArchiveOptions(), 3));
+	ASSERT_EQ(3u, files.size());
+	for(const archive_file &file : files){
+		EXPECT_EQ(expected.header->icao, file.header->icao);
+		for(size_t i=0; i<expected.scan_elevations.size(); i++){
+			if(expected.scan_elevations[i] == nullptr) continue;
+			ASSERT_NE(nullptr, file.scan_elevations[i]);
+			EXPECT_EQ(expected.scan_elevations[i]->radials.size(), file.scan_elevations[i]->radials.size());
+		}
+	}
+
+	std::vector<uint8_t> garbage(stream.begin()+1, stream.end());
+	EXPECT_EQ(-1, Decoder::SplitVolumes(garbage.data(), garbage.size(), spans));
+}
+
+// Tests viewing archive bytes in place, stitching only views that span segments
+TEST(ArchiveViews, ViewsWithoutCopying){
+	Decoder::ArchiveFile file("archives/KDIX20240517_025206_V06");
+	std::vector<uint8_t> all = file.getAll();
+
+	std::vector<std::string_view> segments = file.segmentViews();
+	ASSERT_GT(segments.size(), 1u);
+	std::string joined;
+	for(std::string_view seg : segments) joined.append(seg);
+	EXPECT_EQ(std::string(all.begin(), all.end()), joined);
+
+	// In place within a segment, stitched across the boundary between the first two
+	std::string_view inside = file.view(0, 6);
+	EXPECT_EQ("AR2V00", inside);
+	EXPECT_EQ(segments[0].data(), inside.data());
+	uint64_t boundary = segments[0].size();
+	std::string_view across = file.view(boundary-3, 10);
+	EXPECT_EQ(std::string(all.begin()+boundary-3, all.begin()+boundary+7), across);
+	EXPECT_EQ(0u, file.position());
+
+	EXPECT_EQ(5u, file.view(all.size()-5, 100).size());
+	EXPECT_TRUE(file.view(all.size(), 1).empty());
+
+	std::vector<uint8_t> bulk(all.size());
+	EXPECT_EQ(all.size(), file.read(bulk.data(), bulk.size()+10));
+	EXPECT_EQ(all, bulk);
+
+	std::ostringstream out;
+	EXPECT_EQ(0, file.dump(out));
+	EXPECT_EQ(std::string(all.begin(), all.end()), out.str());
+}
+
+// Tests decoding message header fields through their big endian layouts
+TEST(FieldLayout, DecodesBigEndianFields){
+	std::vector<uint8_t> bytes = {
+		'D', 'R', 'E', 'F', 0, 0, 0, 0,
+		0x07, 0x30,             // 1840 gates
+		0x08, 0x34,             // 2.1 km
+		0x00, 0xFA,             // 0.25 km
+		0x00, 0x10,
+		0xFF, 0xF0,             // -2 dB
+		0x00, 0x08,
+		0x40, 0x00, 0x00, 0x00, // 2.0
+		0x42, 0x02, 0x00, 0x00  // 32.5
+	};
+	Decoder::ArchiveOptions options;
+	options.gzip = false;
+	options.bzip = false;
+	Decoder::ArchiveFile archive(bytes.data(), bytes.size(), options);
+
+	Decoder::moment_block_layout block;
+	ASSERT_EQ(sizeof(block), archive.readLayout(block));
+	EXPECT_EQ(0, std::memcmp(block.type_name, "DREF", 4));
+	EXPECT_EQ(1840, block.num_gates.get());
+	EXPECT_EQ(2100, block.range.get());
+	EXPECT_EQ(250, block.range_interval.get());
+	EXPECT_EQ(-16, block.snr_threshold.get());
+	EXPECT_EQ(8, block.word_size.get());
+	EXPECT_FLOAT_EQ(2.0f, block.scale.get());
+	EXPECT_FLOAT_EQ(32.5f, block.offset.get());
+
+	// Too few bytes left, so nothing is read
+	archive.seek(1);
+	EXPECT_EQ(0u, archive.readLayout(block));
+	EXPECT_EQ(1u, archive.position());
+}
+
+// Tests that the 16 and 32-bit batch byte swap kernels match the scalar swap, including 16-bit gate conversion
+TEST(BatchByteSwap, MatchesScalarSwap){
+	// Odd counts and an unaligned start exercise the scalar tail behind the vector kernels
+	std::vector<uint8_t> raw(4096 | 7);
+	for(size_t i=0; i<raw.size(); i++) raw[i] = static_cast<uint8_t>(i*131 + (i >> 9));
+
+	for(size_t count : {0, 1, 15, 33, 1001}){
+		std::vector<uint16_t> words16(count+1), expected16(count+1);
+		std::memcpy(words16.data(), raw.data()+1, (count+1)*2);
+		for(size_t i=0; i<=count; i++) expected16[i] = Decoder::reverseEndian(words16[i]);
+		expected16[count] = words16[count];
+		Decoder::reverseEndian16(words16.data(), count);
+		EXPECT_EQ(expected16, words16) << count;
+
+		std::vector<uint32_t> words32(count+1), expected32(count+1);
+		std::memcpy(words32.data(), raw.data()+3, (count+1)*4);
+		for(size_t i=0; i<=count; i++) expected32[i] = Decoder::reverseEndian(words32[i]);
+		expected32[count] = words32[count];
+		Decoder::reverseEndian32(words32.data(), count);
+		EXPECT_EQ(expected32, words32) << count;
+	}
+
+	// 16-bit gates are swapped in one batch while converting, with 0 and 1 still below threshold and range folded
+	const uint8_t gates[] = {0x00, 0x00, 0x00, 0x01, 0x01, 0x02, 0x12, 0x34, 0xFF, 0xFE};
+	moment_view ref = {gates, 5, 16, 2.125f, 0.25f, 2.0f, 100.0f, 32.0f};
+	std::shared_ptr<radial_data> converted = std::make_shared<radial_data>();
+	ASSERT_EQ(0, Decoder::Message31::ParseRadial(ref, converted));
+	EXPECT_EQ((std::vector<float>{0, 0, (0x0102 + 32.0f) / 100.0f, (0x1234 + 32.0f) / 100.0f, (0xFFFE + 32.0f) / 100.0f}), converted->ref->data);
+}
+
+// Benchmarks the batch byte swap kernels against the scalar swap (disabled by default, run with --gtest_also_run_disabled_tests)
+TEST(BatchByteSwap, DISABLED_Throughput){
+	constexpr size_t bytes = 1 << 24;
+	constexpr int warmup = 3;
+	constexpr int runs = 20;
+	std::vector<uint8_t> raw(bytes + 1);
+	for(size_t i=0; i<raw.size(); i++) raw[i] = static_cast<uint8_t>(i*131 + (i >> 9));
+	uint8_t *unaligned = raw.data()+1;
+
+	// Median of repeated runs over an unaligned, already warm buffer
+	auto median_secs = [&](auto &&fn){
+		for(int i=0; i<warmup; i++) fn();
+		std::vector<double> secs;
+		for(int i=0; i<runs; i++){
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			fn();
+			secs.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		}
+		std::sort(secs.begin(), secs.end());
+		return secs[secs.size()/2];
+	};
+	uint16_t *words16 = reinterpret_cast<uint16_t*>(unaligned);
+	uint32_t *words32 = reinterpret_cast<uint32_t*>(unaligned);
+	double scalar16 = median_secs([&](){ for(size_t i=0; i<bytes/2; i++) words16[i] = Decoder::reverseEndian(words16[i]); });
+	double batch16 = median_secs([&](){ Decoder::reverseEndian16(words16, bytes/2); });
+	double scalar32 = median_secs([&](){ for(size_t i=0; i<bytes/4; i++) words32[i] = Decoder::reverseEndian(words32[i]); });
+	double batch32 = median_secs([&](){ Decoder::reverseEndian32(words32, bytes/4); });
+
+	double megabytes = bytes / 1e6;
+	std::cout << "16-bit swap: scalar " << megabytes/scalar16 << " MB/s, " << Decoder::byteSwapKernel() << " " << megabytes/batch16 << " MB/s" << std::endl;
+	std::cout << "32-bit swap: scalar " << megabytes/scalar32 << " MB/s, " << Decoder::byteSwapKernel() << " " << megabytes/batch32 << " MB/s" << std::endl;
+}
+
+// Tests building, saving and loading a message index, then decoding straight from it
+TEST(MessageIndex, SeeksStraightToIndexedRadials){
+	archive_file full;
+	ASSERT_EQ(0, Decoder::DecodeArchive("archives/KDIX20240517_025206_V06", false, full));
+	size_t radials = 0;
+	for(const std::shared_ptr<elevation_head> &elevation : full.scan_elevations) if(elevation) radials += elevation->radials.size();
+
+	Decoder::ArchiveFile archive("archives/KDIX20240517_025206_V06");
+	std::vector<message_entry> index;
+	ASSERT_EQ(0, Decoder::BuildMessageIndex(archive, index));
+	EXPECT_EQ(0u, archive.position());
+	ASSERT_FALSE(index.empty());
+	EXPECT_EQ(VOLUME_HEADER_SIZE, index[0].offset);
+	EXPECT_EQ(archive.size(), index.back().offset + index.back().size);
+	EXPECT_EQ(radials, static_cast<size_t>(std::count_if(index.begin(), index.end(),
+		[](const message_entry &entry){ return entry.type == MESSAGE_TYPE_31; })));
+
+	ASSERT_EQ(0, Decoder::SaveMessageIndex("KDIX20240517_025206_V06.idx", archive, index));
+	std::vector<message_entry> loaded;
+	ASSERT_EQ(0, Decoder::LoadMessageIndex("KDIX20240517_025206_V06.idx", archive, loaded));
+	ASSERT_EQ(index.size(), loaded.size());
+	for(size_t i=0; i<index.size(); i++){
+		EXPECT_EQ(index[i].offset, loaded[i].offset);
+		EXPECT_EQ(index[i].size, loaded[i].size);
+		EXPECT_EQ(index[i].type, loaded[i].type);
+		EXPECT_EQ(index[i].elevation_num, loaded[i].elevation_num);
+		EXPECT_EQ(index[i].azimuth_num, loaded[i].azimuth_num);
+	}
+
+	// Another volume of the same size (a later scan time, or different metadata) is refused
+	std::vector<uint8_t> raw = archive.getAll();
+	std::vector<message_entry> mismatched;
+	raw[VOLUME_HEADER_SIZE - 1] ^= 1;
+	Decoder::ArchiveFile later(raw.data(), raw.size());
+	EXPECT_EQ(-1, Decoder::LoadMessageIndex("KDIX20240517_025206_V06.idx", later, mismatched));
+	raw[VOLUME_HEADER_SIZE - 1] ^= 1;
+	raw[VOLUME_HEADER_SIZE + METADATA_RECORD_SIZE/2] ^= 1;
+	Decoder::ArchiveFile remetadata(raw.data(), raw.size());
+	EXPECT_EQ(-1, Decoder::LoadMessageIndex("KDIX20240517_025206_V06.idx", remetadata, mismatched));
+
+	// One sweep, and one radial of another, decoded straight from the index
+	archive_file sweep;
+	ASSERT_EQ(0, Decoder::DecodeIndexedElevation(archive, loaded, 2, sweep));
+	ASSERT_NE(nullptr, sweep.scan_elevations[2]);
+	EXPECT_EQ(nullptr, sweep.scan_elevations[1]);
+	ASSERT_EQ(full.scan_elevations[2]->radials.size(), sweep.scan_elevations[2]->radials.size());
+	for(size_t i=0; i<sweep.scan_elevations[2]->radials.size(); i++)
+		EXPECT_EQ(full.scan_elevations[2]->radials[i]->ref->data, sweep.scan_elevations[2]->radials[i]->ref->data);
+
+	auto radial = std::find_if(loaded.begin(), loaded.end(),
+		[](const message_entry &entry){ return entry.type == MESSAGE_TYPE_31 && entry.elevation_num == 5 && entry.azimuth_num == 100; });
+	ASSERT_NE(loaded.end(), radial);
+	ASSERT_EQ(0, Decoder::DecodeIndexedMessage(archive, *radial, sweep));
+	ASSERT_NE(nullptr, sweep.scan_elevations[5]);
+	EXPECT_EQ(100, sweep.scan_elevations[5]->radials[0]->azimuth_num);
+	EXPECT_EQ(-1, Decoder::DecodeIndexedElevation(archive, loaded, 30, sweep));
+
+	// An extent whose end wraps past 64 bits is refused rather than read out of bounds
+	message_entry wrapped = *radial;
+	wrapped.size = UINT64_MAX - wrapped.offset + 2;
+	EXPECT_EQ(-1, Decoder::DecodeIndexedMessage(archive, wrapped, sweep));
+	std::remove("KDIX20240517_025206_V06.idx");
+}
+
+// Tests reading Message 31 through a cursor bounded by the message extent
+TEST(MessageCursor, ChecksMessageExtentOnce){
+	std::vector<uint8_t> bytes = {0x12, 0x34, 0xAB, 0xCD, 0xEF, 0x01, 0x42, 0x02, 0x00, 0x00, 'x'};
+	Decoder::MessageCursor cursor(std::string_view(reinterpret_cast<const char*>(bytes.data()), bytes.size()));
+	EXPECT_TRUE(cursor.fits(0, bytes.size()));
+	EXPECT_FALSE(cursor.fits(4, bytes.size()));
+	EXPECT_FALSE(cursor.fits(bytes.size()+1, 0));
+	EXPECT_EQ(0x1234, cursor.readIntegral<uint16_t>());
+	EXPECT_EQ(0xABCDEF01u, cursor.readIntegral<uint32_t>());
+	EXPECT_FLOAT_EQ(32.5f, cursor.readFloat());
+	EXPECT_EQ('x', *cursor.take(1));
+	EXPECT_EQ(bytes.size(), cursor.position());
+
+	// A radial whose REF block runs past the message end is rejected rather than read from the next message
+	Decoder::ArchiveFile archive("archives/KDIX20240517_025206_V06");
+	std::vector<message_entry> index;
+	ASSERT_EQ(0, Decoder::BuildMessageIndex(archive, index));
+	auto radial = std::find_if(index.begin(), index.end(), [](const message_entry &entry){ return entry.type == MESSAGE_TYPE_31; });
+	ASSERT_NE(index.end(), radial);
+	uint64_t begin = radial->offset + MESSAGE_PREFIX_SIZE + MESSAGE_HEADER_SIZE;
+
+	archive_file whole, truncated;
+	Decoder::MessageCursor full_message(archive.view(begin, radial->offset + radial->size - begin));
+	ASSERT_EQ(0, Decoder::Message31::ParseMessage31(full_message, whole));
+	// Cut the message just past the REF block header, so its gates are missing
+	uint32_t ref_block = whole.scan_elevations[radial->elevation_num]->radials[0]->ptr_ref_block;
+	Decoder::MessageCursor cut_message(archive.view(begin, ref_block + sizeof(Decoder::moment_block_layout) + 10));
+	ASSERT_EQ(0, Decoder::Message31::ParseMessage31(cut_message, truncated));
+	ASSERT_NE(nullptr, whole.scan_elevations[radial->elevation_num]->radials[0]->ref);
+	EXPECT_EQ(nullptr, truncated.scan_elevations[radial->elevation_num]->radials[0]->ref);
+	Decoder::MessageCursor header_only(archive.view(begin, 20));
+	EXPECT_EQ(-1, Decoder::Message31::ParseMessage31(header_only, truncated));
+}
+
+// Tests collecting decode problems as counted events rather than printing them
+TEST(Diagnostics, CollectsEventsInsteadOfPrinting){
+	archive_file file;
+	ASSERT_EQ(0, Decoder::DecodeArchive("archives/KDIX20240517_025206_V06", false, file));
+	EXPECT_EQ(0u, file.diagnostics.total());
+	EXPECT_GE(file.diagnostics.messageCount(), 6480u);
+	EXPECT_TRUE(file.diagnostics.events().empty());
+
+	// A Message 31 cut off inside its gates is counted, with its message number and offset
+	Decoder::ArchiveFile archive("archives/KDIX20240517_025206_V06");
+	std::vector<message_entry> index;
+	ASSERT_EQ(0, Decoder::BuildMessageIndex(archive, index));
+	auto radial = std::find_if(index.begin(), index.end(), [](const message_entry &entry){ return entry.type == MESSAGE_TYPE_31; });
+	ASSERT_NE(index.end(), radial);
+	uint64_t begin = radial->offset + MESSAGE_PREFIX_SIZE + MESSAGE_HEADER_SIZE;
+	archive_file cut;
+	cut.diagnostics.beginMessage(radial->offset);
+	Decoder::MessageCursor cursor(archive.view(begin, radial->size / 8));
+	Decoder::Message31::ParseMessage31(cursor, cut);
+	EXPECT_EQ(1u, cut.diagnostics.total());
+	ASSERT_EQ(1u, cut.diagnostics.events().size());
+	EXPECT_EQ(1u, cut.diagnostics.events()[0].message_num);
+	EXPECT_EQ(radial->offset, cut.diagnostics.events()[0].offset);
+	EXPECT_EQ(1u, cut.diagnostics.count(cut.diagnostics.events()[0].code));
+
+	// The ring keeps only the latest events, counters keep everything, and merging aggregates both
+	Decoder::Diagnostics ring(2);
+	for(uint64_t offset : {10, 20, 30}){
+		ring.beginMessage(offset);
+		ring.report(Decoder::DiagnosticCode::IMPROPER_SEGMENT_FIELDS);
+	}
+	EXPECT_EQ(3u, ring.count(Decoder::DiagnosticCode::IMPROPER_SEGMENT_FIELDS));
+	std::vector<Decoder::diagnostic_event> latest = ring.events();
+	ASSERT_EQ(2u, latest.size());
+	EXPECT_EQ(20u, latest[0].offset);
+	EXPECT_EQ(30u, latest[1].offset);
+
+	Decoder::Diagnostics aggregate;
+	aggregate.merge(ring);
+	aggregate.merge(cut.diagnostics);
+	EXPECT_EQ(4u, aggregate.total());
+	EXPECT_EQ(3u, aggregate.events().size());
+
+	// Chunked decodes release parsed bytes, offsets still locate the message within the whole volume
+	std::vector<uint8_t> raw = archive.getAll();
+	auto last = std::find_if(index.rbegin(), index.rend(), [](const message_entry &entry){ return entry.type == MESSAGE_TYPE_31; });
+	ASSERT_NE(index.rend(), last);
+	auto dref = std::search(raw.begin()+last->offset, raw.begin()+last->offset+last->size, std::begin("DREF"), std::end("DREF")-1);
+	ASSERT_NE(raw.begin()+last->offset+last->size, dref);
+	*dref = 'X';
+	Decoder::ArchiveOptions raw_options;
+	raw_options.bzip = false;
+	archive_file streamed;
+	Decoder::ChunkDecoder decoder(streamed, nullptr, raw_options);
+	uint64_t split = index[index.size()/2].offset;
+	ASSERT_EQ(0, decoder.push(raw.data(), split));
+	ASSERT_EQ(0, decoder.push(raw.data()+split, raw.size()-split));
+	ASSERT_EQ(1u, streamed.diagnostics.count(Decoder::DiagnosticCode::MISSING_DREF));
+	EXPECT_EQ(last->offset, streamed.diagnostics.events().back().offset);
+}
+
+// Tests pulling radials one at a time as views that match a full decode
+TEST(RadialReader, StreamsRadialsAsViews){
+	archive_file file;
+	ASSERT_EQ(0, Decoder::DecodeArchive("archives/KDIX20240517_025206_V06", false, file));
+
+	Decoder::RadialReader reader("archives/KDIX20240517_025206_V06");
+	ASSERT_EQ(0, reader.status());
+
+	// Views give the same radials in the same order as the full decode, with gates read in place
+	std::array<size_t, 33> counts{};
+	size_t total = 0;
+	for(const radial_view &view : reader){
+		ASSERT_LT(view.elevation_num, file.scan_elevations.size());
+		std::shared_ptr<elevation_head> elevation = file.scan_elevations[view.elevation_num];
+		ASSERT_NE(nullptr, elevation);
+		size_t i = counts[view.elevation_num]++;
+		ASSERT_LT(i, elevation->radials.size());
+		const std::shared_ptr<radial_data> &radial = elevation->radials[i];
+		EXPECT_EQ(radial->azimuth_num, view.azimuth_num);
+		EXPECT_FLOAT_EQ(radial->azimuth, view.azimuth);
+
+		ASSERT_NE(nullptr, view.ref.gates);
+		ASSERT_EQ(radial->ref->num_gates, view.ref.num_gates);
+		std::shared_ptr<radial_data> converted = std::make_shared<radial_data>();
+		ASSERT_EQ(0, Decoder::Message31::ParseRadial(view.ref, converted));
+		EXPECT_EQ(radial->ref->data, converted->ref->data);
+		total++;
+	}
+	EXPECT_EQ(0, reader.status());
+	EXPECT_EQ(0u, reader.diagnostics().total());
+	EXPECT_EQ(6480u, total);
+	for(size_t e=0; e<counts.size(); e++){
+		size_t expected = file.scan_elevations[e] ? file.scan_elevations[e]->radials.size() : 0;
+		EXPECT_EQ(expected, counts[e]);
+	}
+
+	// Exhausted readers stay exhausted
+	radial_view view;
+	EXPECT_FALSE(reader.next(view));
+	EXPECT_TRUE(reader.begin() == reader.end());
+}